@@ -1,5 +1,6 @@
 #pragma once
 
+#include <stdbool.h>
 #include <stdint.h>
 
 static inline uint32_t cm4_get_control(void) {
@@ -14,10 +15,28 @@ static inline void cm4_set_control(uint32_t control) {
 
 static const uint32_t cm4_control_npriv_mask = 1U << 0U;
 
+// IPSR holds the number of the exception being handled, or 0 in thread mode.
+static inline uint32_t cm4_get_ipsr(void) {
+    uint32_t ipsr;
+    __asm volatile("mrs %0, ipsr" : "=r"(ipsr));
+    return ipsr;
+}
+
+static const uint32_t cm4_ipsr_svcall = 11U;
+
 // Interrupt control and state register
 static volatile uint32_t *const cm4_icsr = (volatile uint32_t *)0xE000ED04U;
 
 static const uint32_t cm4_icsr_pendsvset_mask = 1U << 28U;
+static const uint32_t cm4_icsr_pendstset_mask = 1U << 26U;
+
+// SysTick control and status, reload value, and current value registers
+static volatile uint32_t *const cm4_syst_csr = (volatile uint32_t *)0xE000E010U;
+static volatile uint32_t *const cm4_syst_rvr = (volatile uint32_t *)0xE000E014U;
+static volatile uint32_t *const cm4_syst_cvr = (volatile uint32_t *)0xE000E018U;
+
+static const uint32_t cm4_syst_csr_enable_mask = 1U << 0U;
+static const uint32_t cm4_syst_rvr_max = 0x00FFFFFFU;
 
 // Floating point context control register
 static volatile uint32_t *const cm4_fpcsr = (volatile uint32_t *)0xE000EF34U;
@@ -28,8 +47,60 @@ static const uint32_t cm4_fpcsr_lspen_mask = 1U << 30U;
 // Return to thread mode, use PSP, no FP context
 static const uint32_t cm4_exc_return_thread_psp_nofp = 0xFFFFFFFDU;
 
+// Set in EXC_RETURN if the exception frame doesn't include FP state
+static const uint32_t cm4_exc_return_nofp_mask = 1U << 4U;
+
+// Set in EXC_RETURN if the exception was taken from thread mode
+static const uint32_t cm4_exc_return_thread_mask = 1U << 3U;
+
+// Set in the stacked xPSR if a padding word was added above the exception
+// frame to align it to 8 bytes
+static const uint32_t cm4_xpsr_frame_padded_mask = 1U << 9U;
+
 static const uint32_t cm4_epsr_thumb_mask = 1U << 24U;
 
+static inline uint32_t cm4_count_leading_zeros(uint32_t value) {
+    uint32_t count;
+    __asm("clz %0, %1" : "=r"(count) : "r"(value));
+    return count;
+}
+
+static inline uint32_t cm4_count_trailing_zeros(uint32_t value) {
+    uint32_t reversed;
+    __asm("rbit %0, %1" : "=r"(reversed) : "r"(value));
+    return cm4_count_leading_zeros(reversed);
+}
+
+// Exclusive load and store for lock-free updates from thread mode. The store
+// fails if any exception was taken since the matching load because exception
+// entry and return clear the local monitor.
+static inline uint32_t cm4_load_exclusive(volatile uint32_t *addr) {
+    uint32_t value;
+    __asm volatile("ldrex %0, [%1]" : "=r"(value) : "r"(addr) : "memory");
+    return value;
+}
+
+// Returns whether the store succeeded.
+static inline bool cm4_store_exclusive(volatile uint32_t *addr,
+                                       uint32_t value)
+{
+    uint32_t failed;
+    __asm volatile(
+        "strex %0, %2, [%1]"
+        : "=&r"(failed) : "r"(addr), "r"(value) : "memory"
+    );
+    return failed == 0;
+}
+
+static inline void cm4_clear_exclusive(void) {
+    __asm volatile("clrex" : : : "memory");
+}
+
+// Prevents the compiler from moving memory accesses across this point.
+static inline void cm4_compiler_barrier(void) {
+    __asm volatile("" : : : "memory");
+}
+
 static void cm4_wait_for_interrupt(void) {
     __asm volatile("wfi");
 }
@@ -44,3 +115,30 @@ static void cm4_enable_irq(void) {
 static void cm4_disable_irq(void) {
     __asm volatile("cpsid i");
 }
+
+static inline uint32_t cm4_get_basepri(void) {
+    uint32_t basepri;
+    __asm volatile("mrs %0, basepri" : "=r"(basepri));
+    return basepri;
+}
+
+// Interrupts with a priority value greater than or equal to a non-zero BASEPRI
+// are masked. Writing 0 unmasks all interrupts. The ISB makes sure that the new
+// value has taken effect before the next instruction.
+static inline void cm4_set_basepri(uint32_t basepri) {
+    __asm volatile(
+        "msr basepri, %0    \n"
+        "isb                \n"
+        : : "r"(basepri) : "memory"
+    );
+}
+
+// Like cm4_set_basepri() except that the write is ignored if it would unmask
+// any interrupts.
+static inline void cm4_raise_basepri(uint32_t basepri) {
+    __asm volatile(
+        "msr basepri_max, %0    \n"
+        "isb                    \n"
+        : : "r"(basepri) : "memory"
+    );
+}
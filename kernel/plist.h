@@ -0,0 +1,24 @@
+#pragma once
+
+#include "rtos.h"
+#include "tcb.h"
+#include "tlist.h"
+
+// A wait list kept in the order that tasks would be scheduled in, and in FIFO
+// order among tasks that are equal. Unlike a tpq it only costs a head and tail
+// pointer per object, at the price of insertion being O(n) in the number of
+// waiters. The search starts from the back so that adding a waiter of the
+// lowest waiting priority, including when all waiters have the same priority,
+// is constant time.
+static void plist_insert(rtos_tlist_t *tlist, rtos_tcb_t *task) {
+    rtos_tcb_t *pos = tlist->tail;
+    while (pos != NULL && tcb_runs_before(task, pos)) {
+        pos = pos->prev;
+    }
+    tlist_insert_before(tlist, pos == NULL ? tlist->head : pos->next, task);
+}
+
+// Returns NULL if the list is empty.
+static rtos_tcb_t *plist_pop_front(rtos_tlist_t *tlist) {
+    return tlist_is_empty(tlist) ? NULL : tlist_pop_front(tlist);
+}
@@ -15,24 +15,40 @@ static bool queue_is_full(const rtos_mqueue_t *queue) {
     return queue->is_full;
 }
 
-static void queue_enqueue(rtos_mqueue_t *queue, const void *data) {
+static uint8_t *queue_slot(const rtos_mqueue_t *queue, size_t index) {
+    return &queue->data[index * queue->slot_size];
+}
+
+// Publishes the slot at the head, which must already hold the message.
+static void queue_push(rtos_mqueue_t *queue) {
     ASSERT(!queue_is_full(queue));
-    const size_t index = queue->head * queue->slot_size;
-    for (size_t i = 0; i < queue->slot_size; ++i) {
-        queue->data[index + i] = ((uint8_t *)data)[i];
-    }
     queue->head = (queue->head + 1) % queue->slots;
     if (queue->head == queue->tail) {
         queue->is_full = true;
     }
 }
 
+// Frees the slot at the tail.
+static void queue_pop(rtos_mqueue_t *queue) {
+    ASSERT(!queue_is_empty(queue));
+    queue->tail = (queue->tail + 1) % queue->slots;
+    queue->is_full = false;
+}
+
+static void queue_enqueue(rtos_mqueue_t *queue, const void *data) {
+    ASSERT(!queue_is_full(queue));
+    uint8_t *const slot = queue_slot(queue, queue->head);
+    for (size_t i = 0; i < queue->slot_size; ++i) {
+        slot[i] = ((uint8_t *)data)[i];
+    }
+    queue_push(queue);
+}
+
 static void queue_dequeue(rtos_mqueue_t *queue, void *data) {
     ASSERT(!queue_is_empty(queue));
-    const size_t index = queue->tail * queue->slot_size;
+    const uint8_t *const slot = queue_slot(queue, queue->tail);
     for (size_t i = 0; i < queue->slot_size; ++i) {
-        ((uint8_t *)data)[i] = queue->data[index + i];
+        ((uint8_t *)data)[i] = slot[i];
     }
-    queue->tail = (queue->tail + 1) % queue->slots;
-    queue->is_full = false;
+    queue_pop(queue);
 }
@@ -0,0 +1,38 @@
+#pragma once
+
+#include "cortex_m4.h"
+#include "rtos.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// The head and tail are free-running counts of slots written and read. Only
+// the producer writes the head and only the consumer writes the tail so
+// neither side needs a lock. The number of slots is a power of two so that a
+// count maps to a slot with a mask and the counts can wrap.
+
+static inline bool ring_is_empty(const rtos_ring_t *ring) {
+    return ring->head == ring->tail;
+}
+
+static inline uint8_t *ring_slot(const rtos_ring_t *ring, size_t count) {
+    return ring->data + (count & (ring->slots - 1)) * ring->slot_size;
+}
+
+// Slots are copied a word at a time when the size and both pointers allow it.
+static inline void ring_copy(void *dst, const void *src, size_t size) {
+    if (((size | (size_t)dst | (size_t)src) & 3U) == 0) {
+        uint32_t *const dst_words = dst;
+        const uint32_t *const src_words = src;
+        for (size_t i = 0; i < size / 4; ++i) {
+            dst_words[i] = src_words[i];
+        }
+    } else {
+        uint8_t *const dst_bytes = dst;
+        const uint8_t *const src_bytes = src;
+        for (size_t i = 0; i < size; ++i) {
+            dst_bytes[i] = src_bytes[i];
+        }
+    }
+}
@@ -1,12 +1,18 @@
 #include "cortex_m4.h"
 #include "rtos.h"
+#include "plist.h"
 #include "queue.h"
+#include "ring.h"
 #include "stack_frame.h"
+#include "stream.h"
+#include "syscall.h"
 #include "rtos_assert.h"
 #include "rtos_state.h"
 #include "tcb.h"
 #include "tlist.h"
 #include "tpq.h"
+#include "wheel.h"
+#include "workq.h"
 
 #include <stdbool.h>
 #include <stddef.h>
@@ -14,31 +20,214 @@
 
 static_assert(RTOS_TICKS_PER_SLICE > 0, "Must have at least 1 tick per slice");
 static_assert(RTOS_NUM_PRIORITY_LEVELS >= 2, "");
+static_assert(!RTOS_ENABLE_EDF ||
+              (RTOS_EDF_PRIORITY > 0 &&
+               RTOS_EDF_PRIORITY <= RTOS_MAX_TASK_PRIORITY),
+              "EDF priority must be above the idle task's priority");
+static_assert(RTOS_NVIC_PRIORITY_BITS >= 1 && RTOS_NVIC_PRIORITY_BITS <= 8, "");
+static_assert(RTOS_MAX_SYSCALL_IRQ_PRIORITY > 0 &&
+              RTOS_MAX_SYSCALL_IRQ_PRIORITY < (1 << RTOS_NVIC_PRIORITY_BITS),
+              "BASEPRI can't mask priority 0 and must mask PendSV");
+static_assert(RTOS_WORKER_STACK_SIZE % 8 == 0 &&
+              RTOS_WORKER_STACK_SIZE >= 256, "Invalid worker stack size");
 
 // All of the kernel's state is stored here
 static rtos_state_t state = {0};
 
+// BASEPRI value that masks every interrupt that's allowed to call the kernel
+enum {
+    KERNEL_BASEPRI = RTOS_MAX_SYSCALL_IRQ_PRIORITY <<
+                     (8 - RTOS_NVIC_PRIORITY_BITS),
+};
+
+// Starts a critical section for code that modifies the kernel's state. Returns
+// the previous BASEPRI to pass to kernel_unlock().
+static inline uint32_t kernel_lock(void) {
+    const uint32_t basepri = cm4_get_basepri();
+    cm4_raise_basepri(KERNEL_BASEPRI);
+    return basepri;
+}
+
+static inline void kernel_unlock(uint32_t basepri) {
+    cm4_set_basepri(basepri);
+}
+
 static inline void pend_context_switch(void) {
     *cm4_icsr |= cm4_icsr_pendsvset_mask;
 }
 
+// Only a system call trapped from thread mode can block the current task. An
+// interrupt handler calls the implementation directly, so blocking there would
+// block whichever task it interrupted.
+static inline void assert_can_block(void) {
+    USAGE_ASSERT(cm4_get_ipsr() == cm4_ipsr_svcall,
+                 "Blocking call made from an interrupt handler");
+}
+
+// For calls that act on behalf of the current task even when they don't block,
+// such as taking ownership of a mutex.
+static inline void assert_called_by_task(void) {
+    USAGE_ASSERT(cm4_get_ipsr() == cm4_ipsr_svcall,
+                 "Task-only call made from an interrupt handler");
+}
+
+// The kernel info and task counters are published with a sequence lock. They're
+// only written by handlers that hold the kernel lock, so a reader that was
+// interrupted by a write just reads again.
+static inline void info_write_begin(void) {
+    state.info_seq = state.info_seq + 1;
+    cm4_compiler_barrier();
+}
+
+static inline void info_write_end(void) {
+    cm4_compiler_barrier();
+    state.info_seq = state.info_seq + 1;
+}
+
+// The ticks are charged to the running task's counters.
+static void tick_count_advance(size_t ticks) {
+    state.tick_count += ticks;
+    info_write_begin();
+    state.info.tick_count += ticks;
+    if (state.curr_task != NULL) {
+        state.curr_task->counters.run_ticks += ticks;
+    }
+    info_write_end();
+}
+
 static void idle_task(void *args) {
     while (true) {
         cm4_wait_for_interrupt();
     }
 }
 
-static bool preempt_current_task(rtos_tcb_t *task) {
-    return task->priority > state.curr_task->priority ||
+#if RTOS_ENABLE_DEFERRED_WORK
+
+static rtos_work_t *work_take(void);
+
+// Runs work posted by interrupts. The worker is only made ready when work is
+// posted while it's waiting so a burst of posts causes a single context switch
+// and the worker then drains everything that's pending in priority order.
+static void worker_task(void *args) {
+    while (true) {
+        rtos_work_t *const work = work_take();
+        if (work != NULL) {
+            work->function(work->arg);
+        }
+    }
+}
+
+#endif // #if RTOS_ENABLE_DEFERRED_WORK
+
+#if RTOS_ENABLE_TICKLESS_IDLE
+
+// Stops SysTick from interrupting on every tick until the next sleeping task
+// is due to wake. The tick count is caught up in rtos_tick() when the period
+// elapses, or in tickless_resume_ticks() if a task becomes ready before then.
+static void tickless_suppress_ticks(void) {
+    const size_t max_ticks = (cm4_syst_rvr_max + 1) / state.cycles_per_tick;
+    const size_t idle_ticks = wheel_next_expiry(&state.sleeping_tasks,
+                                                state.tick_count, max_ticks);
+    if (idle_ticks < 2) {
+        return;
+    }
+
+    *cm4_syst_csr &= ~cm4_syst_csr_enable_mask;
+
+    // A tick that's already pending hasn't been counted yet so ticks can't be
+    // suppressed until it's been handled.
+    if (*cm4_icsr & cm4_icsr_pendstset_mask) {
+        *cm4_syst_csr |= cm4_syst_csr_enable_mask;
+        return;
+    }
+
+    // The current value is the number of cycles until the next tick.
+    *cm4_syst_rvr = *cm4_syst_cvr +
+                    (idle_ticks - 1) * state.cycles_per_tick - 1;
+    *cm4_syst_cvr = 0;
+    *cm4_syst_csr |= cm4_syst_csr_enable_mask;
+    state.suppressed_ticks = idle_ticks;
+}
+
+// Ends a tickless period early. The tick count is advanced by the number of
+// whole ticks that have elapsed and SysTick is restarted so that the next tick
+// happens when it would have if ticks had never been suppressed.
+static void tickless_resume_ticks(void) {
+    *cm4_syst_csr &= ~cm4_syst_csr_enable_mask;
+
+    // If the tickless period has fully elapsed, rtos_tick() is pending and
+    // will catch up the tick count.
+    if (*cm4_icsr & cm4_icsr_pendstset_mask) {
+        *cm4_syst_csr |= cm4_syst_csr_enable_mask;
+        return;
+    }
+
+    // Ticks happen every cycles_per_tick cycles counting back from the end of
+    // the tickless period.
+    const uint32_t cycles_left = *cm4_syst_cvr;
+    tick_count_advance(state.suppressed_ticks - 1 -
+                       cycles_left / state.cycles_per_tick);
+    state.suppressed_ticks = 0;
+
+    const uint32_t next_tick_cycles =
+        cycles_left % state.cycles_per_tick ?: state.cycles_per_tick;
+    *cm4_syst_rvr = next_tick_cycles - 1;
+    *cm4_syst_cvr = 0;
+    *cm4_syst_csr |= cm4_syst_csr_enable_mask;
+    *cm4_syst_rvr = state.cycles_per_tick - 1;
+}
+
+#endif // #if RTOS_ENABLE_TICKLESS_IDLE
+
+static bool preempt_current_task(void) {
+    return tpq_has_higher(&state.ready_tasks, state.curr_task) ||
             state.curr_task == &state.idle_task;
 }
 
+// Starts a new job for a deadline task, which runs until it next sleeps.
+static void release_task(rtos_tcb_t *task) {
+    if (task->deadline != 0) {
+        task->abs_deadline = state.tick_count + task->deadline;
+    }
+}
+
+#if RTOS_ENABLE_EDF_ADMISSION
+
+enum { EDF_UTILIZATION_ONE = 1U << 16U };
+
+// Rounded up so that the admission check errs on the side of rejecting.
+static uint32_t edf_utilization(size_t wcet, size_t deadline) {
+    return ((uint64_t)wcet * EDF_UTILIZATION_ONE + deadline - 1) / deadline;
+}
+
+#endif // #if RTOS_ENABLE_EDF_ADMISSION
+
+// A task blocked in a timed call is on its wait list and in the timer wheel at
+// the same time. Whichever ends the wait takes it out of the other: a waker
+// stops the timer here, and an expired timer takes the task off its wait list
+// in wait_time_out().
+static void wait_start_timeout(void *object, size_t timeout) {
+    rtos_tcb_t *const task = state.curr_task;
+    task->wait_object = object;
+    if (timeout != RTOS_WAIT_FOREVER) {
+        task->timer.wake_time = state.tick_count + timeout;
+        wheel_insert(&state.sleeping_tasks, &task->timer, state.tick_count);
+    }
+}
+
+static void wait_stop_timeout(rtos_tcb_t *task) {
+    if (wheel_contains(&task->timer)) {
+        wheel_remove(&state.sleeping_tasks, &task->timer);
+    }
+}
+
 static void make_task_ready(rtos_tcb_t *task) {
+    wait_stop_timeout(task);
     task->state = RTOS_TASKSTATE_READY;
     tpq_push_back(&state.ready_tasks, task);
 
     if (state.curr_task != NULL &&
-        preempt_current_task(task) &&
+        preempt_current_task() &&
         !state.is_preempting)
     {
         state.is_preempting = true;
@@ -58,6 +247,10 @@ static void prv_start(void) {
 
     *cm4_fpcsr |= cm4_fpcsr_aspen_mask | cm4_fpcsr_lspen_mask;
 
+#if RTOS_ENABLE_TICKLESS_IDLE
+    state.cycles_per_tick = *cm4_syst_rvr + 1;
+#endif
+
     tcb_init(&state.idle_task, &(rtos_task_settings_t){
         .function   = idle_task,
         .task_arg   = NULL,
@@ -66,10 +259,26 @@ static void prv_start(void) {
         .priority   = 0,
     });
 
+#if RTOS_ENABLE_DEFERRED_WORK
+    // The worker runs first so that it picks up any work posted before the
+    // RTOS was started. It's privileged since the work was deferred from
+    // interrupt handlers.
+    tcb_init(&state.worker_task, &(rtos_task_settings_t){
+        .function   = worker_task,
+        .task_arg   = NULL,
+        .stack_low  = state.worker_task_stack,
+        .stack_size = sizeof(state.worker_task_stack),
+        .priority   = RTOS_MAX_TASK_PRIORITY,
+        .privileged = true,
+        .policy     = RTOS_SCHED_FIFO,
+    });
+    tpq_push_back(&state.ready_tasks, &state.worker_task);
+#endif
+
     pend_context_switch();
 }
 
-static void prv_task_create(rtos_tcb_t *task,
+static bool prv_task_create(rtos_tcb_t *task,
                             const rtos_task_settings_t *settings)
 {
     USAGE_ASSERT(settings->function != NULL, "Passed NULL task function");
@@ -81,24 +290,56 @@ static void prv_task_create(rtos_tcb_t *task,
                  "Stack size must be multiple of 8");
     USAGE_ASSERT(settings->priority <= RTOS_MAX_TASK_PRIORITY,
                  "Task priority must be at most RTOS_MAX_TASK_PRIORITY");
+    USAGE_ASSERT(settings->policy == RTOS_SCHED_RR ||
+                 settings->policy == RTOS_SCHED_FIFO,
+                 "Invalid scheduling policy");
+    USAGE_ASSERT(settings->budget == 0 ||
+                 settings->budget <= settings->budget_period,
+                 "Budget must be at most the budget period");
+#if RTOS_ENABLE_EDF
+    USAGE_ASSERT((settings->deadline != 0) ==
+                     (settings->priority == RTOS_EDF_PRIORITY),
+                 "Only tasks at RTOS_EDF_PRIORITY must have a deadline");
+#else
+    USAGE_ASSERT(settings->deadline == 0, "EDF scheduling is disabled");
+#endif
+
+#if RTOS_ENABLE_EDF_ADMISSION
+    if (settings->deadline != 0) {
+        USAGE_ASSERT(settings->wcet > 0 && settings->wcet <= settings->deadline,
+                     "Deadline tasks need a WCET of at most their deadline");
+        const uint32_t utilization =
+            edf_utilization(settings->wcet, settings->deadline);
+        if (state.edf_utilization + utilization > EDF_UTILIZATION_ONE) {
+            return false;
+        }
+        state.edf_utilization += utilization;
+    }
+#endif
 
     tcb_init(task, settings);
-
+    task->replenish_time = state.tick_count + task->budget_period;
+    release_task(task);
     make_task_ready(task);
-}
-
-static rtos_tcb_t *prv_task_self(void) {
-    USAGE_ASSERT(state.is_started, "RTOS must be started before calling");
-    return state.curr_task;
+    return true;
 }
 
 static void prv_task_exit(void) {
     USAGE_ASSERT(state.is_started, "RTOS must be started before calling");
+    assert_can_block();
+
+#if RTOS_ENABLE_EDF_ADMISSION
+    if (state.curr_task->deadline != 0) {
+        state.edf_utilization -= edf_utilization(state.curr_task->wcet,
+                                                 state.curr_task->deadline);
+    }
+#endif
 
     while (!tlist_is_empty(&state.curr_task->waiting_to_join)) {
         rtos_tcb_t *const task =
             tlist_pop_front(&state.curr_task->waiting_to_join);
         ASSERT(task->state == RTOS_TASKSTATE_WAIT_JOIN);
+        wait_stop_timeout(task);
         task->state = RTOS_TASKSTATE_READY;
         tpq_push_back(&state.ready_tasks, task);
     }
@@ -121,19 +362,98 @@ static void prv_task_yield(void) {
     }
 }
 
+static void task_sleep_until(rtos_tcb_t *task, size_t wake_time) {
+    task->timer.wake_time = wake_time;
+    task->state = RTOS_TASKSTATE_SLEEPING;
+    wheel_insert(&state.sleeping_tasks, &task->timer, state.tick_count);
+    pend_context_switch();
+}
+
+// Refills a task's execution time budget. Periods that passed while the task
+// wasn't running are skipped rather than accumulated.
+static void budget_replenish(rtos_tcb_t *task) {
+    const size_t missed =
+        (state.tick_count - task->replenish_time) / task->budget_period;
+    task->replenish_time += (missed + 1) * task->budget_period;
+    task->budget_left = task->budget;
+}
+
+// A running task that has used up its budget is throttled until its next
+// replenishment. Throttling a task that holds a mutex would block every task
+// waiting on it, so it's deferred until the task releases its last mutex.
+static void budget_throttle_if_exhausted(rtos_tcb_t *task) {
+    if (task->budget != 0 && task->budget_left == 0 &&
+        task->mutex_count == 0 && task->inherit_held == NULL &&
+        task->state == RTOS_TASKSTATE_RUNNING)
+    {
+        ++task->stats.throttles;
+        task_sleep_until(task, task->replenish_time);
+        task->state = RTOS_TASKSTATE_THROTTLED;
+    }
+}
+
+// Charges the current tick to a task's execution time budget.
+static void budget_charge(rtos_tcb_t *task) {
+    if (tick_is_reached(task->replenish_time, state.tick_count)) {
+        budget_replenish(task);
+    }
+    if (task->budget_left > 0) {
+        --task->budget_left;
+    }
+    budget_throttle_if_exhausted(task);
+}
+
 static void prv_task_sleep(size_t ticks) {
     USAGE_ASSERT(state.is_started, "RTOS must be started before calling");
     USAGE_ASSERT(ticks > 0, "Number of ticks must be greater than zero");
 
-    state.curr_task->wake_time = state.tick_count + ticks;
-    state.curr_task->state = RTOS_TASKSTATE_SLEEPING;
-    tlist_insert_ascending(&state.sleeping_tasks, state.curr_task);
+    assert_can_block();
+    task_sleep_until(state.curr_task, state.tick_count + ticks);
+}
+
+static void prv_task_sleep_until(size_t *last_wake, size_t period) {
+    USAGE_ASSERT(last_wake != NULL, "Passed NULL last wake time");
+    USAGE_ASSERT(state.is_started, "RTOS must be started before calling");
+    USAGE_ASSERT(period > 0, "Period must be greater than zero");
+
+    rtos_tcb_t *const task = state.curr_task;
 
-    pend_context_switch();
+    // The first call puts the task in periodic mode with the current tick as
+    // its previous release.
+    if (task->period == 0) {
+        *last_wake = state.tick_count;
+    } else {
+        const size_t response_time = state.tick_count - task->release_time;
+        if (response_time > task->stats.max_response_time) {
+            task->stats.max_response_time = response_time;
+        }
+    }
+    task->period = period;
+
+    // The next release is relative to the previous one rather than to the
+    // current tick so that the period doesn't drift.
+    const size_t release_time = *last_wake + period;
+    *last_wake = release_time;
+    task->release_time = release_time;
+
+    if (!tick_is_reached(release_time, state.tick_count)) {
+        assert_can_block();
+        task->job_started = false;
+        task_sleep_until(task, release_time);
+    } else {
+        // The next release is already due so the task keeps running.
+        ++task->stats.overruns;
+        const size_t jitter = state.tick_count - release_time;
+        if (jitter > task->stats.max_release_jitter) {
+            task->stats.max_release_jitter = jitter;
+        }
+        task->job_started = true;
+    }
 }
 
 static void prv_task_suspend(void) {
     USAGE_ASSERT(state.is_started, "RTOS must be started before calling");
+    assert_can_block();
     state.curr_task->state = RTOS_TASKSTATE_SUSPENDED;
     pend_context_switch();
 }
@@ -142,36 +462,235 @@ static void prv_task_resume(rtos_tcb_t *task) {
     USAGE_ASSERT(task != NULL, "Passed NULL task handle");
     USAGE_ASSERT(state.is_started, "RTOS must be started before calling");
     if (task->state == RTOS_TASKSTATE_SUSPENDED) {
+        release_task(task);
         make_task_ready(task);
     }
 }
 
-static void prv_task_join(rtos_tcb_t *task) {
+// Returns false if the timeout expires.
+static bool prv_task_join_timed(rtos_tcb_t *task, size_t timeout) {
     USAGE_ASSERT(task != NULL, "Passed NULL task handle");
     USAGE_ASSERT(state.is_started, "RTOS must be started before calling");
 
-    tlist_push_back(&task->waiting_to_join, state.curr_task);
-    state.curr_task->state = RTOS_TASKSTATE_WAIT_JOIN;
+    if (timeout != 0) {
+        assert_can_block();
+        plist_insert(&task->waiting_to_join, state.curr_task);
+        state.curr_task->state = RTOS_TASKSTATE_WAIT_JOIN;
+        wait_start_timeout(task, timeout);
+        pend_context_switch();
+    }
+    return timeout != 0;
+}
+
+static void prv_task_join(rtos_tcb_t *task) {
+    prv_task_join_timed(task, RTOS_WAIT_FOREVER);
+}
+
+static void prv_task_get_stats(const rtos_tcb_t *task,
+                               rtos_task_stats_t *stats)
+{
+    USAGE_ASSERT(task != NULL, "Passed NULL task handle");
+    USAGE_ASSERT(stats != NULL, "Passed NULL stats");
+    *stats = task->stats;
+    stats->budget_left = task->budget_left;
+}
+
+// Returns false if the action is overwrite-if-empty and the notification isn't
+// empty. The task is only woken once the value becomes non-zero since that is
+// what it waits for.
+static bool prv_task_notify(rtos_tcb_t *task, uint32_t value,
+                            rtos_notify_action_t action)
+{
+    USAGE_ASSERT(task != NULL, "Passed NULL task handle");
+    if (action == RTOS_NOTIFY_SET_BITS) {
+        task->notify_value |= value;
+    } else if (action == RTOS_NOTIFY_INCREMENT) {
+        ++task->notify_value;
+    } else if (action == RTOS_NOTIFY_OVERWRITE) {
+        task->notify_value = value;
+    } else {
+        USAGE_ASSERT(action == RTOS_NOTIFY_OVERWRITE_IF_EMPTY,
+                     "Invalid notify action");
+        if (task->notify_value != 0) {
+            return false;
+        }
+        task->notify_value = value;
+    }
+
+    if (task->state == RTOS_TASKSTATE_WAIT_NOTIFY && task->notify_value != 0) {
+        make_task_ready(task);
+    }
+    return true;
+}
+
+// The value itself is taken by the task once it runs again, so a task notified
+// several times before it gets to run sees all of them. Returns false if the
+// timeout expires.
+static bool prv_task_notify_wait(size_t timeout) {
+    USAGE_ASSERT(state.is_started, "RTOS must be started before calling");
+    if (state.curr_task->notify_value != 0) {
+        return true;
+    } else if (timeout == 0) {
+        return false;
+    }
+    assert_can_block();
+    ASSERT(state.curr_task->state == RTOS_TASKSTATE_RUNNING);
+    state.curr_task->state = RTOS_TASKSTATE_WAIT_NOTIFY;
+    wait_start_timeout(NULL, timeout);
     pend_context_switch();
+    return true;
 }
 
 static void prv_mutex_create(rtos_mutex_t *mutex, size_t priority_ceil) {
     USAGE_ASSERT(priority_ceil <= RTOS_MAX_TASK_PRIORITY, "");
     mutex->owner = NULL;
-    tpq_init(&mutex->blocked);
+    mutex->blocked.head = NULL;
+    mutex->blocked.tail = NULL;
     mutex->priority_ceil = priority_ceil;
+    mutex->inherit = false;
+    mutex->next_held = NULL;
+}
+
+static void prv_mutex_create_inherit(rtos_mutex_t *mutex) {
+    mutex->owner = NULL;
+    mutex->blocked.head = NULL;
+    mutex->blocked.tail = NULL;
+    mutex->priority_ceil = 0;
+    mutex->inherit = true;
+    mutex->next_held = NULL;
 }
 
 static void prv_mutex_destroy(rtos_mutex_t *mutex) {
     USAGE_ASSERT(mutex != NULL, "Passed NULL mutex");
     USAGE_ASSERT(mutex->owner == NULL,
                  "Destroying mutex that tasks are still waiting on");
-    ASSERT(tpq_is_empty(&mutex->blocked));
+    ASSERT(tlist_is_empty(&mutex->blocked));
+}
+
+// A task runs at its base priority, which is its default priority or the
+// ceiling of the ceiling locks it holds, unless a higher priority task is
+// blocked on one of the inheritance mutexes it holds.
+static size_t mutex_inherited_priority(const rtos_tcb_t *task) {
+    size_t priority = task->base_priority;
+    for (const rtos_mutex_t *mutex = task->inherit_held; mutex != NULL;
+         mutex = mutex->next_held)
+    {
+        const rtos_tcb_t *const waiter = mutex->blocked.head;
+        if (waiter != NULL && waiter->priority > priority) {
+            priority = waiter->priority;
+        }
+    }
+    return priority;
+}
+
+// Returns the wait list of a blocked task if the list is ordered by priority,
+// or NULL otherwise.
+static rtos_tlist_t *plist_of_waiting_task(const rtos_tcb_t *task) {
+    if (task->state == RTOS_TASKSTATE_WAIT_JOIN) {
+        rtos_tcb_t *const joining = task->wait_object;
+        return &joining->waiting_to_join;
+    } else if (task->state == RTOS_TASKSTATE_WAIT_MUTEX) {
+        rtos_mutex_t *const mutex = task->wait_object;
+        return &mutex->blocked;
+    } else if (task->state == RTOS_TASKSTATE_WAIT_COND) {
+        rtos_cond_t *const cond = task->wait_object;
+        return &cond->waiting;
+    } else if (task->state == RTOS_TASKSTATE_WAIT_SEM) {
+        rtos_sem_t *const sem = task->wait_object;
+        return &sem->waiting;
+    } else if (task->state == RTOS_TASKSTATE_WAIT_ENQUEUE ||
+               task->state == RTOS_TASKSTATE_WAIT_RESERVE)
+    {
+        rtos_mqueue_t *const mqueue = task->wait_object;
+        return &mqueue->producers;
+    } else if (task->state == RTOS_TASKSTATE_WAIT_DEQUEUE ||
+               task->state == RTOS_TASKSTATE_WAIT_ACQUIRE)
+    {
+        rtos_mqueue_t *const mqueue = task->wait_object;
+        return &mqueue->consumers;
+    } else if (task->state == RTOS_TASKSTATE_WAIT_READ) {
+        rtos_rwlock_t *const rwlock = task->wait_object;
+        return &rwlock->waiting_readers;
+    } else if (task->state == RTOS_TASKSTATE_WAIT_WRITE) {
+        rtos_rwlock_t *const rwlock = task->wait_object;
+        return &rwlock->waiting_writers;
+    }
+    return NULL;
+}
+
+// Changes the priority of a task, keeping it in order if it's ready or on a
+// wait list ordered by priority. Returns the owner of the inheritance mutex the
+// task is blocked on, if any, since the change has to be passed on to it.
+static rtos_tcb_t *mutex_set_priority(rtos_tcb_t *task, size_t priority) {
+    if (task->state == RTOS_TASKSTATE_READY) {
+        tpq_remove(&state.ready_tasks, task);
+        task->priority = priority;
+        tpq_push_back(&state.ready_tasks, task);
+        return NULL;
+    }
+
+    rtos_tlist_t *const waiting = plist_of_waiting_task(task);
+    rtos_tcb_t *next = NULL;
+    if (task->state == RTOS_TASKSTATE_WAIT_MUTEX) {
+        rtos_mutex_t *const mutex = task->wait_object;
+        if (mutex->inherit) {
+            next = mutex->owner;
+        }
+    }
+
+    if (waiting != NULL) {
+        tlist_remove(waiting, task);
+    }
+    task->priority = priority;
+    if (waiting != NULL) {
+        plist_insert(waiting, task);
+    }
+    return next;
+}
+
+// Recomputes the priority of a task holding inheritance mutexes after a task
+// starts or stops waiting on one of them. The change is passed along the chain
+// of owners for as long as each is blocked on another inheritance mutex.
+// Callers are responsible for preempting the current task if needed.
+static void mutex_update_priority(rtos_tcb_t *task) {
+    while (task != NULL) {
+        const size_t priority = mutex_inherited_priority(task);
+        if (priority == task->priority) {
+            break;
+        }
+        task = mutex_set_priority(task, priority);
+    }
+}
+
+static void mutex_block(rtos_mutex_t *mutex, rtos_tcb_t *task) {
+    task->state = RTOS_TASKSTATE_WAIT_MUTEX;
+    task->wait_object = mutex;
+    plist_insert(&mutex->blocked, task);
+    if (mutex->inherit) {
+        mutex_update_priority(mutex->owner);
+    }
+}
+
+static void mutex_held_remove(rtos_tcb_t *task, rtos_mutex_t *mutex) {
+    rtos_mutex_t **link = &task->inherit_held;
+    while (*link != mutex) {
+        ASSERT(*link != NULL);
+        link = &(*link)->next_held;
+    }
+    *link = mutex->next_held;
+    mutex->next_held = NULL;
 }
 
+// The task must not be in any queue.
 static void mutex_lock_helper(rtos_mutex_t *mutex, rtos_tcb_t *task) {
-    task->priority = mutex->priority_ceil;
-    ++task->mutex_count;
+    if (mutex->inherit) {
+        mutex->next_held = task->inherit_held;
+        task->inherit_held = mutex;
+    } else {
+        task->base_priority = mutex->priority_ceil;
+        ++task->mutex_count;
+    }
+    task->priority = mutex_inherited_priority(task);
     mutex->owner = task;
 }
 
@@ -189,29 +708,33 @@ static void mutex_unlock_helper(rtos_mutex_t *mutex) {
 
     bool context_switch = false;
 
+    // The old owner stops inheriting from the waiters once the mutex is gone.
     rtos_tcb_t *const old_owner = mutex->owner;
-    --old_owner->mutex_count;
-    if (old_owner->mutex_count == 0) {
-        old_owner->priority = old_owner->def_priority;
-        for (int i = old_owner->priority + 1; i <= RTOS_MAX_TASK_PRIORITY; ++i) {
-            if (!tlist_is_empty(&state.ready_tasks.tlists[i])) {
-                context_switch = true;
-                break;
-            }
+    if (mutex->inherit) {
+        mutex_held_remove(old_owner, mutex);
+    } else if (--old_owner->mutex_count == 0) {
+        old_owner->base_priority = old_owner->def_priority;
+    }
+    const size_t priority = mutex_inherited_priority(old_owner);
+    if (priority != old_owner->priority) {
+        old_owner->priority = priority;
+        if (tpq_has_higher(&state.ready_tasks, old_owner)) {
+            context_switch = true;
         }
     }
 
-    rtos_tcb_t *const unblocked = tpq_pop_front(&mutex->blocked);
+    rtos_tcb_t *const unblocked = plist_pop_front(&mutex->blocked);
     if (unblocked == NULL) {
         // No tasks were waiting to aquire so the mutex becomes unlocked.
         mutex->owner = NULL;
     } else {
         // Pass the mutex to the unblocked task.
         ASSERT(unblocked->state == RTOS_TASKSTATE_WAIT_MUTEX);
+        wait_stop_timeout(unblocked);
         mutex_lock_helper(mutex, unblocked);
         unblocked->state = RTOS_TASKSTATE_READY;
         tpq_push_back(&state.ready_tasks, unblocked);
-        if (unblocked->priority > state.curr_task->priority) {
+        if (tcb_runs_before(unblocked, state.curr_task)) {
             context_switch = true;
         }
     }
@@ -227,9 +750,11 @@ static void mutex_unlock_helper(rtos_mutex_t *mutex) {
 static bool prv_mutex_trylock(rtos_mutex_t *mutex) {
     USAGE_ASSERT(mutex != NULL, "Passed NULL mutex");
     USAGE_ASSERT(state.is_started, "RTOS must be started before calling");
-    USAGE_ASSERT((state.curr_task->mutex_count == 0 &&
+    assert_called_by_task();
+    USAGE_ASSERT(mutex->inherit ||
+                 (state.curr_task->mutex_count == 0 &&
                     state.curr_task->def_priority <= mutex->priority_ceil) ||
-                 state.curr_task->priority == mutex->priority_ceil,
+                 state.curr_task->base_priority == mutex->priority_ceil,
                  "Current task cannot lock mutex");
     USAGE_ASSERT(mutex->owner != state.curr_task,
                  "Attempt to double lock mutex");
@@ -237,33 +762,198 @@ static bool prv_mutex_trylock(rtos_mutex_t *mutex) {
     return mutex_trylock_helper(mutex, state.curr_task);
 }
 
-static void prv_mutex_lock(rtos_mutex_t *mutex) {
+// Returns false if the timeout expires.
+static bool prv_mutex_lock_timed(rtos_mutex_t *mutex, size_t timeout) {
     USAGE_ASSERT(mutex != NULL, "Passed NULL mutex handle");
     USAGE_ASSERT(state.is_started, "RTOS must be started before calling");
-    USAGE_ASSERT((state.curr_task->mutex_count == 0 &&
+    assert_called_by_task();
+    USAGE_ASSERT(mutex->inherit ||
+                 (state.curr_task->mutex_count == 0 &&
                     state.curr_task->def_priority <= mutex->priority_ceil) ||
-                 state.curr_task->priority == mutex->priority_ceil,
+                 state.curr_task->base_priority == mutex->priority_ceil,
                  "Current task cannot lock mutex");
     USAGE_ASSERT(mutex->owner != state.curr_task,
                  "Attempt to double lock mutex");
 
     if (!mutex_trylock_helper(mutex, state.curr_task)) {
+        if (timeout == 0) {
+            return false;
+        }
+        assert_can_block();
         ASSERT(state.curr_task->state == RTOS_TASKSTATE_RUNNING);
-        state.curr_task->state = RTOS_TASKSTATE_WAIT_MUTEX;
-        tpq_push_back(&mutex->blocked, state.curr_task);
+        mutex_block(mutex, state.curr_task);
+        wait_start_timeout(mutex, timeout);
         pend_context_switch();
     }
+    return true;
+}
+
+static void prv_mutex_lock(rtos_mutex_t *mutex) {
+    prv_mutex_lock_timed(mutex, RTOS_WAIT_FOREVER);
 }
 
 static void prv_mutex_unlock(rtos_mutex_t *mutex) {
     USAGE_ASSERT(mutex != NULL, "Passed NULL mutex handle");
     USAGE_ASSERT(state.is_started, "RTOS must be started before calling");
+    assert_called_by_task();
     USAGE_ASSERT(mutex->owner == state.curr_task,
                  "Task other than owner tried to unlock mutex");
 
     mutex_unlock_helper(mutex);
+    budget_throttle_if_exhausted(state.curr_task);
+}
+
+static void rwlock_lock_helper(rtos_rwlock_t *rwlock, rtos_tcb_t *task,
+                               bool write)
+{
+    task->base_priority = rwlock->priority_ceil;
+    task->priority = mutex_inherited_priority(task);
+    ++task->mutex_count;
+    if (write) {
+        rwlock->writer = task;
+    } else {
+        ++rwlock->readers;
+    }
+}
+
+// Passes the rwlock to a task that was waiting for it. Returns whether the
+// task should run before the current task.
+static bool rwlock_grant(rtos_rwlock_t *rwlock, rtos_tcb_t *task) {
+    ASSERT(task->state == RTOS_TASKSTATE_WAIT_READ ||
+           task->state == RTOS_TASKSTATE_WAIT_WRITE);
+    rwlock_lock_helper(rwlock, task,
+                       task->state == RTOS_TASKSTATE_WAIT_WRITE);
+    task->state = RTOS_TASKSTATE_READY;
+    tpq_push_back(&state.ready_tasks, task);
+    return tcb_runs_before(task, state.curr_task);
+}
+
+// Once the rwlock is free, the readers that queued behind a writer get it
+// after a write unlock and the next writer gets it after a read unlock. This
+// way neither readers nor writers can be starved by the other.
+static void rwlock_unlock_helper(rtos_rwlock_t *rwlock) {
+    bool context_switch = false;
+
+    rtos_tcb_t *const task = state.curr_task;
+    --task->mutex_count;
+    if (task->mutex_count == 0) {
+        task->base_priority = task->def_priority;
+        task->priority = mutex_inherited_priority(task);
+        if (tpq_has_higher(&state.ready_tasks, task)) {
+            context_switch = true;
+        }
+    }
+
+    const bool was_write = rwlock->writer == task;
+    if (was_write) {
+        rwlock->writer = NULL;
+    } else {
+        --rwlock->readers;
+    }
+
+    if (rwlock->readers == 0) {
+        if (was_write && !tlist_is_empty(&rwlock->waiting_readers)) {
+            while (!tlist_is_empty(&rwlock->waiting_readers)) {
+                rtos_tcb_t *const reader =
+                    tlist_pop_front(&rwlock->waiting_readers);
+                if (rwlock_grant(rwlock, reader)) {
+                    context_switch = true;
+                }
+            }
+        } else if (!tlist_is_empty(&rwlock->waiting_writers)) {
+            rtos_tcb_t *const writer =
+                tlist_pop_front(&rwlock->waiting_writers);
+            if (rwlock_grant(rwlock, writer)) {
+                context_switch = true;
+            }
+        }
+    }
+
+    if (context_switch) {
+        state.is_preempting = true;
+        state.curr_task->state = RTOS_TASKSTATE_READY;
+        tpq_push_front(&state.ready_tasks, state.curr_task);
+        pend_context_switch();
+    }
+}
+
+static void prv_rwlock_lock(rtos_rwlock_t *rwlock, bool write) {
+    USAGE_ASSERT(rwlock != NULL, "Passed NULL rwlock");
+    USAGE_ASSERT(state.is_started, "RTOS must be started before calling");
+    USAGE_ASSERT((state.curr_task->mutex_count == 0 &&
+                    state.curr_task->def_priority <= rwlock->priority_ceil) ||
+                 state.curr_task->base_priority == rwlock->priority_ceil,
+                 "Current task cannot lock rwlock");
+    USAGE_ASSERT(rwlock->writer != state.curr_task,
+                 "Attempt to lock rwlock while holding it for writing");
+
+    const bool can_lock = write
+        ? rwlock->writer == NULL && rwlock->readers == 0
+        : rwlock->writer == NULL && tlist_is_empty(&rwlock->waiting_writers);
+    if (can_lock) {
+        rwlock_lock_helper(rwlock, state.curr_task, write);
+    } else {
+        assert_can_block();
+        ASSERT(state.curr_task->state == RTOS_TASKSTATE_RUNNING);
+        state.curr_task->state = write ? RTOS_TASKSTATE_WAIT_WRITE
+                                       : RTOS_TASKSTATE_WAIT_READ;
+        state.curr_task->wait_object = rwlock;
+        plist_insert(write ? &rwlock->waiting_writers
+                           : &rwlock->waiting_readers,
+                     state.curr_task);
+        pend_context_switch();
+    }
+}
+
+static void prv_rwlock_read_lock(rtos_rwlock_t *rwlock) {
+    prv_rwlock_lock(rwlock, false);
+}
+
+static void prv_rwlock_write_lock(rtos_rwlock_t *rwlock) {
+    prv_rwlock_lock(rwlock, true);
+}
+
+static void prv_rwlock_read_unlock(rtos_rwlock_t *rwlock) {
+    USAGE_ASSERT(rwlock != NULL, "Passed NULL rwlock");
+    USAGE_ASSERT(state.is_started, "RTOS must be started before calling");
+    USAGE_ASSERT(rwlock->writer == NULL && rwlock->readers > 0,
+                 "Tried to read unlock rwlock that isn't read locked");
+    USAGE_ASSERT(state.curr_task->mutex_count > 0,
+                 "Task doesn't hold any locks");
+
+    rwlock_unlock_helper(rwlock);
+    budget_throttle_if_exhausted(state.curr_task);
+}
+
+static void prv_rwlock_write_unlock(rtos_rwlock_t *rwlock) {
+    USAGE_ASSERT(rwlock != NULL, "Passed NULL rwlock");
+    USAGE_ASSERT(state.is_started, "RTOS must be started before calling");
+    USAGE_ASSERT(rwlock->writer == state.curr_task,
+                 "Task other than writer tried to write unlock rwlock");
+
+    rwlock_unlock_helper(rwlock);
+    budget_throttle_if_exhausted(state.curr_task);
+}
+
+#if RTOS_ENABLE_MUTEX_FAST_PATH
+
+// Called by a task that lowered its own priority or released its last mutex
+// outside of the kernel to do what the kernel would have done on unlock.
+static void prv_task_reschedule(void) {
+    USAGE_ASSERT(state.is_started, "RTOS must be started before calling");
+    budget_throttle_if_exhausted(state.curr_task);
+    if (state.curr_task->state == RTOS_TASKSTATE_RUNNING &&
+        tpq_has_higher(&state.ready_tasks, state.curr_task))
+    {
+        state.is_preempting = true;
+        state.curr_task->state = RTOS_TASKSTATE_READY;
+        tpq_push_front(&state.ready_tasks, state.curr_task);
+        pend_context_switch();
+    }
 }
 
+#endif // #if RTOS_ENABLE_MUTEX_FAST_PATH
+
 static void prv_cond_create(rtos_cond_t *cond) {
     cond->mutex = NULL;
     cond->waiting.head = NULL;
@@ -277,26 +967,40 @@ static void prv_cond_destroy(rtos_cond_t *cond) {
     ASSERT(cond->mutex == NULL);
 }
 
-static void prv_cond_wait(rtos_cond_t *cond, rtos_mutex_t *mutex) {
+// Returns false if the timeout expires. The mutex is reacquired either way.
+static bool prv_cond_wait_timed(rtos_cond_t *cond, rtos_mutex_t *mutex,
+                                size_t timeout)
+{
     USAGE_ASSERT(cond != NULL, "Passed NULL cond handle");
     USAGE_ASSERT(mutex != NULL, "Passed NULL mutex handle");
     USAGE_ASSERT(state.is_started, "RTOS must be started before calling");
     USAGE_ASSERT(cond->mutex == NULL || cond->mutex == mutex, 
                  "The cv is already associated with another mutex");
 
+    if (timeout == 0) {
+        return false;
+    }
+
+    assert_can_block();
     mutex_unlock_helper(mutex);
 
     cond->mutex = mutex;
     state.curr_task->state = RTOS_TASKSTATE_WAIT_COND;
-    tlist_push_back(&cond->waiting, state.curr_task);
+    plist_insert(&cond->waiting, state.curr_task);
+    wait_start_timeout(cond, timeout);
     pend_context_switch();
+    return true;
+}
+
+static void prv_cond_wait(rtos_cond_t *cond, rtos_mutex_t *mutex) {
+    prv_cond_wait_timed(cond, mutex, RTOS_WAIT_FOREVER);
 }
 
 static void cond_wake_task(rtos_cond_t *cond) {
     rtos_tcb_t *const waken = tlist_pop_front(&cond->waiting);
     ASSERT(waken->state == RTOS_TASKSTATE_WAIT_COND);
-    waken->state = RTOS_TASKSTATE_WAIT_MUTEX;
-    tpq_push_back(&cond->mutex->blocked, waken);
+    wait_stop_timeout(waken);
+    mutex_block(cond->mutex, waken);
 }
 
 static void prv_cond_signal(rtos_cond_t *cond) {
@@ -323,162 +1027,1124 @@ static void prv_cond_broadcast(rtos_cond_t *cond) {
     cond->mutex = NULL;
 }
 
-static void prv_mqueue_create(rtos_mqueue_t *mqueue, uint8_t *buffer,
-                              size_t slots, size_t slot_size)
-{
-    *mqueue = (rtos_mqueue_t){
-        .slots = slots,
-        .slot_size = slot_size,
-        .head = 0,
-        .tail = 0,
-        .is_full = false,
-        .waiting = {0},
-        .data = buffer,
-    };
+// Takes a task whose timeout expired off the list it was waiting on. Returns
+// false if the task has to keep waiting, which is only the case when a cond
+// wait times out and the mutex is held by another task.
+static bool wait_time_out(rtos_tcb_t *task) {
+    bool timed_out = true;
+    if (task->state == RTOS_TASKSTATE_WAIT_JOIN) {
+        rtos_tcb_t *const joining = task->wait_object;
+        tlist_remove(&joining->waiting_to_join, task);
+        *task->syscall_result = false;
+    } else if (task->state == RTOS_TASKSTATE_WAIT_MUTEX) {
+        rtos_mutex_t *const mutex = task->wait_object;
+        tlist_remove(&mutex->blocked, task);
+        *task->syscall_result = false;
+        if (mutex->inherit) {
+            mutex_update_priority(mutex->owner);
+        }
+    } else if (task->state == RTOS_TASKSTATE_WAIT_COND) {
+        rtos_cond_t *const cond = task->wait_object;
+        rtos_mutex_t *const mutex = cond->mutex;
+        tlist_remove(&cond->waiting, task);
+        if (tlist_is_empty(&cond->waiting)) {
+            cond->mutex = NULL;
+        }
+        *task->syscall_result = false;
+        if (!mutex_trylock_helper(mutex, task)) {
+            mutex_block(mutex, task);
+            timed_out = false;
+        }
+    } else if (task->state == RTOS_TASKSTATE_WAIT_SEM) {
+        rtos_sem_t *const sem = task->wait_object;
+        tlist_remove(&sem->waiting, task);
+        *task->syscall_result = false;
+    } else if (task->state == RTOS_TASKSTATE_WAIT_NOTIFY) {
+        *task->syscall_result = false;
+    } else if (task->state == RTOS_TASKSTATE_WAIT_SELECT) {
+        rtos_select_t *const select = task->wait_object;
+        tlist_remove(&select->waiting, task);
+        *task->syscall_result = RTOS_SELECT_TIMED_OUT;
+    } else if (task->state == RTOS_TASKSTATE_WAIT_EVENT) {
+        rtos_event_group_t *const group = task->wait_object;
+        tlist_remove(&group->waiting, task);
+        *task->syscall_result = 0;
+    } else if (task->state == RTOS_TASKSTATE_WAIT_ENQUEUE) {
+        // The result already holds the number of messages moved
+        rtos_mqueue_t *const mqueue = task->wait_object;
+        tlist_remove(&mqueue->producers, task);
+    } else {
+        ASSERT(task->state == RTOS_TASKSTATE_WAIT_DEQUEUE);
+        rtos_mqueue_t *const mqueue = task->wait_object;
+        tlist_remove(&mqueue->consumers, task);
+    }
+    return timed_out;
 }
 
-static void prv_mqueue_destroy(rtos_mqueue_t *mqueue) {}
+static bool mqueue_can_consume(const rtos_mqueue_t *mqueue);
 
-static bool mqueue_try_enqueue(rtos_mqueue_t *mqueue, const void *data) {
-    bool success = false;
-    if (!queue_is_full(mqueue)) {
-        if (tlist_is_empty(&mqueue->waiting)) {
-            queue_enqueue(mqueue, data);
-        } else {
-            rtos_tcb_t *const waken = tlist_pop_front(&mqueue->waiting);
-            ASSERT(waken->state == RTOS_TASKSTATE_WAIT_DEQUEUE);
-            for (size_t i = 0; i < mqueue->slot_size; ++i) {
-                waken->mqueue_data[i] = ((uint8_t *)data)[i];
-            }
-            make_task_ready(waken);
+static bool select_member_ready(const rtos_select_member_t *member) {
+    if (member->kind == RTOS_SELECT_MQUEUE) {
+        return mqueue_can_consume(member->object);
+    } else if (member->kind == RTOS_SELECT_SEM) {
+        const rtos_sem_t *const sem = member->object;
+        return sem->count > 0;
+    } else {
+        ASSERT(member->kind == RTOS_SELECT_EVENT_GROUP);
+        const rtos_event_group_t *const group = member->object;
+        return (group->flags & member->flags) != 0;
+    }
+}
+
+// Result of a select wait that was woken by a member. The task checks the
+// members again before returning, since another task may have taken from the
+// member first.
+#define SELECT_WOKEN (RTOS_SELECT_TIMED_OUT - 1)
+
+// Called by a member whenever it may have become ready. A task can only be on
+// one wait list, so tasks wait on the select rather than on each member and
+// the members forward their wakeups through this hook. Every waiting task is
+// woken since any of them may take from the member.
+static void select_notify(rtos_select_t *select, const void *object) {
+    if (select == NULL || tlist_is_empty(&select->waiting)) {
+        return;
+    }
+    size_t index = 0;
+    while (select->members[index].object != object) {
+        ++index;
+        ASSERT(index < select->count);
+    }
+    if (!select_member_ready(&select->members[index])) {
+        return;
+    }
+    while (!tlist_is_empty(&select->waiting)) {
+        rtos_tcb_t *const waken = tlist_pop_front(&select->waiting);
+        ASSERT(waken->state == RTOS_TASKSTATE_WAIT_SELECT);
+        *waken->syscall_result = SELECT_WOKEN;
+        make_task_ready(waken);
+    }
+}
+
+// Returns the index of a ready member, SELECT_WOKEN if a member became ready
+// while the task was blocked, or RTOS_SELECT_TIMED_OUT if the timeout expires.
+static size_t prv_select_wait(rtos_select_t *select, size_t timeout) {
+    USAGE_ASSERT(select != NULL, "Passed NULL select");
+    for (size_t i = 0; i < select->count; ++i) {
+        if (select_member_ready(&select->members[i])) {
+            return i;
         }
-        success = true;
     }
-    return success;
+    if (timeout != 0) {
+        assert_can_block();
+        ASSERT(state.curr_task->state == RTOS_TASKSTATE_RUNNING);
+        state.curr_task->state = RTOS_TASKSTATE_WAIT_SELECT;
+        tlist_push_back(&select->waiting, state.curr_task);
+        wait_start_timeout(select, timeout);
+        pend_context_switch();
+    }
+    return RTOS_SELECT_TIMED_OUT;
+}
+
+static void prv_mqueue_create(rtos_mqueue_t *mqueue, uint8_t *buffer,
+                              size_t slots, size_t slot_size)
+{
+    *mqueue = (rtos_mqueue_t){
+        .slots = slots,
+        .slot_size = slot_size,
+        .head = 0,
+        .tail = 0,
+        .is_full = false,
+        .producers = {0},
+        .consumers = {0},
+        .reserved_by = NULL,
+        .acquired_by = NULL,
+        .data = buffer,
+        .select = NULL,
+    };
+}
+
+static void prv_mqueue_destroy(rtos_mqueue_t *mqueue) {
+    USAGE_ASSERT(tlist_is_empty(&mqueue->producers) &&
+                 tlist_is_empty(&mqueue->consumers),
+                 "Destroying mqueue that tasks are still waiting on");
+    USAGE_ASSERT(mqueue->reserved_by == NULL && mqueue->acquired_by == NULL,
+                 "Tried to destroy mqueue with a reserved or acquired slot");
+    USAGE_ASSERT(mqueue->select == NULL,
+                 "Destroying mqueue that is still a member of a select");
+}
+
+// A reserved slot at the head blocks other producers and an acquired slot at
+// the tail blocks other consumers, so that slots are published and freed in
+// order.
+static bool mqueue_can_produce(const rtos_mqueue_t *mqueue) {
+    return !queue_is_full(mqueue) && mqueue->reserved_by == NULL;
+}
+
+static bool mqueue_can_consume(const rtos_mqueue_t *mqueue) {
+    return !queue_is_empty(mqueue) && mqueue->acquired_by == NULL;
+}
+
+// Adds count messages to the result of a task at the front of a wait list,
+// and readies it once it has moved its minimum.
+static void mqueue_advance(rtos_mqueue_t *mqueue, rtos_tlist_t *waiting,
+                           rtos_tcb_t *task, size_t count)
+{
+    ASSERT(waiting->head == task);
+    task->wait_data += count * mqueue->slot_size;
+    task->wait_count -= count;
+    *task->syscall_result += count;
+    if (*task->syscall_result >= task->wait_min) {
+        tlist_pop_front(waiting);
+        make_task_ready(task);
+    }
+}
+
+// Each of these moves at most one message or slot to the first waiting task
+// and returns whether anything moved.
+static bool mqueue_feed_consumer(rtos_mqueue_t *mqueue) {
+    rtos_tcb_t *const waken = mqueue->consumers.head;
+    if (waken == NULL || !mqueue_can_consume(mqueue)) {
+        return false;
+    }
+    if (waken->state == RTOS_TASKSTATE_WAIT_DEQUEUE) {
+        queue_dequeue(mqueue, waken->wait_data);
+        mqueue_advance(mqueue, &mqueue->consumers, waken, 1);
+    } else {
+        ASSERT(waken->state == RTOS_TASKSTATE_WAIT_ACQUIRE);
+        mqueue->acquired_by = waken;
+        tlist_pop_front(&mqueue->consumers);
+        make_task_ready(waken);
+    }
+    return true;
+}
+
+static bool mqueue_feed_producer(rtos_mqueue_t *mqueue) {
+    rtos_tcb_t *const waken = mqueue->producers.head;
+    if (waken == NULL || !mqueue_can_produce(mqueue)) {
+        return false;
+    }
+    if (waken->state == RTOS_TASKSTATE_WAIT_ENQUEUE) {
+        queue_enqueue(mqueue, waken->wait_data);
+        mqueue_advance(mqueue, &mqueue->producers, waken, 1);
+    } else {
+        ASSERT(waken->state == RTOS_TASKSTATE_WAIT_RESERVE);
+        mqueue->reserved_by = waken;
+        tlist_pop_front(&mqueue->producers);
+        make_task_ready(waken);
+    }
+    return true;
+}
+
+// Lets waiting tasks proceed in priority order for as long as they can. Each
+// consumer that takes a message may free a slot for a producer and vice versa.
+static void mqueue_wake_waiters(rtos_mqueue_t *mqueue) {
+    bool progress;
+    do {
+        progress = mqueue_feed_consumer(mqueue);
+        progress = mqueue_feed_producer(mqueue) || progress;
+    } while (progress);
+}
+
+static void mqueue_block(rtos_mqueue_t *mqueue, rtos_tlist_t *waiting,
+                         rtos_taskstate_t new_state, void *data, size_t count,
+                         size_t min_count)
+{
+    assert_can_block();
+    ASSERT(state.curr_task->state == RTOS_TASKSTATE_RUNNING);
+    state.curr_task->state = new_state;
+    state.curr_task->wait_object = mqueue;
+    plist_insert(waiting, state.curr_task);
+    state.curr_task->wait_data = data;
+    state.curr_task->wait_count = count;
+    state.curr_task->wait_min = min_count;
+    pend_context_switch();
+}
+
+// Moves up to count messages into the queue and returns how many moved. A
+// consumer waiting on an empty queue is copied to directly rather than through
+// a slot. Consumers are only readied once they have their minimum, so a batch
+// wakes each of them at most once.
+static size_t mqueue_produce(rtos_mqueue_t *mqueue, const uint8_t *data,
+                             size_t count)
+{
+    size_t moved = 0;
+    while (moved < count && mqueue_can_produce(mqueue)) {
+        const uint8_t *const src = &data[moved * mqueue->slot_size];
+        rtos_tcb_t *const consumer = mqueue->consumers.head;
+        if (consumer != NULL && queue_is_empty(mqueue) &&
+            consumer->state == RTOS_TASKSTATE_WAIT_DEQUEUE)
+        {
+            size_t n = count - moved;
+            if (n > consumer->wait_count) {
+                n = consumer->wait_count;
+            }
+            for (size_t i = 0; i < n * mqueue->slot_size; ++i) {
+                consumer->wait_data[i] = src[i];
+            }
+            mqueue_advance(mqueue, &mqueue->consumers, consumer, n);
+            moved += n;
+        } else {
+            queue_enqueue(mqueue, src);
+            ++moved;
+            mqueue_feed_consumer(mqueue);
+        }
+    }
+    select_notify(mqueue->select, mqueue);
+    return moved;
+}
+
+// Moves up to count messages out of the queue and returns how many moved.
+// Waiting producers refill the freed slots as they go.
+static size_t mqueue_consume(rtos_mqueue_t *mqueue, uint8_t *data,
+                             size_t count)
+{
+    size_t moved = 0;
+    while (moved < count && mqueue_can_consume(mqueue)) {
+        queue_dequeue(mqueue, &data[moved * mqueue->slot_size]);
+        ++moved;
+        mqueue_feed_producer(mqueue);
+    }
+    return moved;
+}
+
+// Returns the number of messages moved, which a blocked task's wakers add to.
+static size_t prv_mqueue_enqueue_n(rtos_mqueue_t *mqueue, const void *data,
+                                 size_t count, size_t min_count,
+                                 size_t timeout)
+{
+    USAGE_ASSERT(min_count <= count, "Minimum count is more than the count");
+    const size_t moved = mqueue_produce(mqueue, data, count);
+    if (moved < min_count && timeout != 0) {
+        mqueue_block(mqueue, &mqueue->producers, RTOS_TASKSTATE_WAIT_ENQUEUE,
+                     (uint8_t *)data + moved * mqueue->slot_size,
+                     count - moved, min_count);
+        wait_start_timeout(mqueue, timeout);
+    }
+    return moved;
+}
+
+// Returns the number of messages moved, which a blocked task's wakers add to.
+static size_t prv_mqueue_dequeue_n(rtos_mqueue_t *mqueue, void *data,
+                                 size_t count, size_t min_count,
+                                 size_t timeout)
+{
+    USAGE_ASSERT(min_count <= count, "Minimum count is more than the count");
+    const size_t moved = mqueue_consume(mqueue, data, count);
+    if (moved < min_count && timeout != 0) {
+        mqueue_block(mqueue, &mqueue->consumers, RTOS_TASKSTATE_WAIT_DEQUEUE,
+                     (uint8_t *)data + moved * mqueue->slot_size,
+                     count - moved, min_count);
+        wait_start_timeout(mqueue, timeout);
+    }
+    return moved;
 }
 
 static void prv_mqueue_enqueue(rtos_mqueue_t *mqueue, const void *data) {
-    if (!mqueue_try_enqueue(mqueue, data)) {
+    prv_mqueue_enqueue_n(mqueue, data, 1, 1, RTOS_WAIT_FOREVER);
+}
+
+static void prv_mqueue_dequeue(rtos_mqueue_t *mqueue, void *data) {
+    prv_mqueue_dequeue_n(mqueue, data, 1, 1, RTOS_WAIT_FOREVER);
+}
+
+// The task owns the slot at the head once this returns, whether or not it had
+// to wait for it.
+static void prv_mqueue_reserve(rtos_mqueue_t *mqueue) {
+    USAGE_ASSERT(mqueue->reserved_by != state.curr_task,
+                 "Task already has a slot reserved");
+    if (mqueue_can_produce(mqueue)) {
+        mqueue->reserved_by = state.curr_task;
+    } else {
+        mqueue_block(mqueue, &mqueue->producers, RTOS_TASKSTATE_WAIT_RESERVE,
+                     NULL, 0, 0);
+    }
+}
+
+static void prv_mqueue_commit(rtos_mqueue_t *mqueue) {
+    USAGE_ASSERT(mqueue->reserved_by == state.curr_task,
+                 "Task doesn't have a slot reserved");
+    mqueue->reserved_by = NULL;
+    queue_push(mqueue);
+    mqueue_wake_waiters(mqueue);
+    select_notify(mqueue->select, mqueue);
+}
+
+// The task owns the slot at the tail once this returns, whether or not it had
+// to wait for it.
+static void prv_mqueue_acquire(rtos_mqueue_t *mqueue) {
+    USAGE_ASSERT(mqueue->acquired_by != state.curr_task,
+                 "Task already has a slot acquired");
+    if (mqueue_can_consume(mqueue)) {
+        mqueue->acquired_by = state.curr_task;
+    } else {
+        mqueue_block(mqueue, &mqueue->consumers, RTOS_TASKSTATE_WAIT_ACQUIRE,
+                     NULL, 0, 0);
+    }
+}
+
+static void prv_mqueue_release(rtos_mqueue_t *mqueue) {
+    USAGE_ASSERT(mqueue->acquired_by == state.curr_task,
+                 "Task doesn't have a slot acquired");
+    mqueue->acquired_by = NULL;
+    queue_pop(mqueue);
+    mqueue_wake_waiters(mqueue);
+    select_notify(mqueue->select, mqueue);
+}
+
+#if RTOS_ENABLE_DEFERRED_WORK
+
+// Returns NULL and blocks the worker if there's no pending work. The worker
+// then calls this again once it's been made ready.
+static rtos_work_t *prv_work_take(void) {
+    ASSERT(state.curr_task == &state.worker_task);
+    rtos_work_t *const work = workq_pop_highest(&state.pending_work);
+    if (work != NULL) {
+        work->is_pending = false;
+    } else {
+        assert_can_block();
         ASSERT(state.curr_task->state == RTOS_TASKSTATE_RUNNING);
-        state.curr_task->state = RTOS_TASKSTATE_WAIT_ENQUEUE;
-        tlist_push_back(&mqueue->waiting, state.curr_task);
-        state.curr_task->mqueue_data = (void *)data;
+        state.curr_task->state = RTOS_TASKSTATE_WAIT_WORK;
         pend_context_switch();
     }
+    return work;
 }
 
-static void prv_mqueue_dequeue(rtos_mqueue_t *mqueue, void *data) {
-    if (!queue_is_empty(mqueue)) {
-        queue_dequeue(mqueue, data);
-        if (!tlist_is_empty(&mqueue->waiting)) {
-            rtos_tcb_t *const waken = tlist_pop_front(&mqueue->waiting);
-            ASSERT(waken->state == RTOS_TASKSTATE_WAIT_ENQUEUE);
-            queue_enqueue(mqueue, waken->mqueue_data);
-            make_task_ready(waken);
+#endif // #if RTOS_ENABLE_DEFERRED_WORK
+
+// Moves as much of a send as fits and returns how many bytes moved. A message
+// goes in whole or not at all.
+static size_t stream_put(rtos_stream_t *stream, const uint8_t *data,
+                         size_t len)
+{
+    if (stream->is_message) {
+        if (len + STREAM_HEADER_SIZE > stream_free(stream)) {
+            return 0;
+        }
+        stream_write(stream, &len, STREAM_HEADER_SIZE);
+    } else if (len > stream_free(stream)) {
+        len = stream_free(stream);
+    }
+    stream_write(stream, data, len);
+    return len;
+}
+
+// Returns false if a receiver needing at least min_len bytes has to wait.
+// Otherwise stores how many bytes were received, which for a message buffer is
+// 0 if the next message is longer than max_len. That message is left in place.
+static bool stream_take(rtos_stream_t *stream, uint8_t *data, size_t max_len,
+                        size_t min_len, size_t *received)
+{
+    if (stream->used < min_len) {
+        return false;
+    }
+    size_t len;
+    if (!stream->is_message) {
+        len = stream->used < max_len ? stream->used : max_len;
+    } else if (stream->used == 0) {
+        len = 0;
+    } else {
+        stream_peek(stream, &len, STREAM_HEADER_SIZE);
+        if (len > max_len) {
+            *received = 0;
+            return true;
+        }
+        stream_read(stream, &len, STREAM_HEADER_SIZE);
+    }
+    stream_read(stream, data, len);
+    *received = len;
+    return true;
+}
+
+// A receiver waits for the trigger level, or a whole message, but never for
+// more than it asked for.
+static size_t stream_receive_min(const rtos_stream_t *stream, size_t max_len) {
+    if (stream->is_message) {
+        return 1;
+    }
+    const size_t min_len = stream->trigger < max_len ? stream->trigger
+                                                     : max_len;
+    return min_len ?: 1;
+}
+
+// Lets waiting tasks proceed in FIFO order for as long as they can. A receiver
+// is only readied once it can take at least its minimum, and a sender once all
+// of its bytes are in.
+static void stream_wake_waiters(rtos_stream_t *stream) {
+    bool progress;
+    do {
+        progress = false;
+        rtos_tcb_t *const receiver = stream->receivers.head;
+        size_t received;
+        if (receiver != NULL &&
+            stream_take(stream, receiver->wait_data, receiver->wait_count,
+                        receiver->wait_min, &received))
+        {
+            *receiver->syscall_result = received;
+            tlist_pop_front(&stream->receivers);
+            make_task_ready(receiver);
+            progress = true;
+        }
+        rtos_tcb_t *const sender = stream->senders.head;
+        if (sender != NULL) {
+            const size_t sent = stream_put(stream, sender->wait_data,
+                                           sender->wait_count);
+            sender->wait_data += sent;
+            sender->wait_count -= sent;
+            if (sender->wait_count == 0) {
+                tlist_pop_front(&stream->senders);
+                make_task_ready(sender);
+            }
+            progress = progress || sent != 0;
         }
+    } while (progress);
+}
+
+// Sends as much as can go in without waiting and returns how many bytes went
+// in. Senders that are already waiting go first.
+static size_t stream_send_now(rtos_stream_t *stream, const uint8_t *data,
+                              size_t len)
+{
+    size_t sent = 0;
+    if (tlist_is_empty(&stream->senders)) {
+        size_t n;
+        while (sent < len &&
+               (n = stream_put(stream, &data[sent], len - sent)) != 0)
+        {
+            sent += n;
+            stream_wake_waiters(stream);
+        }
+    }
+    return sent;
+}
+
+static void prv_stream_send(rtos_stream_t *stream, const void *data,
+                            size_t len)
+{
+    USAGE_ASSERT(!stream->is_message ||
+                 (len != 0 && len + STREAM_HEADER_SIZE <= stream->size),
+                 "Message doesn't fit in the message buffer");
+    const size_t sent = stream_send_now(stream, data, len);
+    if (sent < len) {
+        assert_can_block();
+        ASSERT(state.curr_task->state == RTOS_TASKSTATE_RUNNING);
+        state.curr_task->state = RTOS_TASKSTATE_WAIT_STREAM_SEND;
+        tlist_push_back(&stream->senders, state.curr_task);
+        state.curr_task->wait_data = (uint8_t *)data + sent;
+        state.curr_task->wait_count = len - sent;
+        pend_context_switch();
+    }
+}
+
+// Returns the number of bytes received, which is set by the sender that wakes
+// the task if it has to wait.
+static size_t prv_stream_receive(rtos_stream_t *stream, void *data,
+                                 size_t max_len)
+{
+    USAGE_ASSERT(max_len != 0, "Receive buffer is empty");
+    const size_t min_len = stream_receive_min(stream, max_len);
+    size_t received;
+    if (tlist_is_empty(&stream->receivers) &&
+        stream_take(stream, data, max_len, min_len, &received))
+    {
+        stream_wake_waiters(stream);
+        return received;
+    } else {
+        assert_can_block();
+        ASSERT(state.curr_task->state == RTOS_TASKSTATE_RUNNING);
+        state.curr_task->state = RTOS_TASKSTATE_WAIT_STREAM_RECEIVE;
+        tlist_push_back(&stream->receivers, state.curr_task);
+        state.curr_task->wait_data = data;
+        state.curr_task->wait_count = max_len;
+        state.curr_task->wait_min = min_len;
+        pend_context_switch();
+        return 0;
+    }
+}
+
+// Returns the length of the removed message, or 0 if the buffer is empty. Any
+// receivers are only waiting while it's empty, so only senders can proceed.
+static size_t prv_msgbuf_discard(rtos_msgbuf_t *msgbuf) {
+    USAGE_ASSERT(msgbuf != NULL, "Passed NULL message buffer");
+    rtos_stream_t *const stream = &msgbuf->stream;
+    size_t len = 0;
+    if (stream->used != 0) {
+        stream_read(stream, &len, STREAM_HEADER_SIZE);
+        stream_discard(stream, len);
+        stream_wake_waiters(stream);
+    }
+    return len;
+}
+
+// Returns false if the count is already at its maximum. A waiting task takes
+// the given count directly so it can't be taken by another task first.
+static bool prv_sem_give(rtos_sem_t *sem) {
+    USAGE_ASSERT(sem != NULL, "Passed NULL semaphore");
+    rtos_tcb_t *const waken = plist_pop_front(&sem->waiting);
+    if (waken != NULL) {
+        ASSERT(waken->state == RTOS_TASKSTATE_WAIT_SEM);
+        *waken->syscall_result = true;
+        make_task_ready(waken);
+    } else if (sem->count < sem->max_count) {
+        ++sem->count;
+        select_notify(sem->select, sem);
     } else {
+        return false;
+    }
+    return true;
+}
+
+// Returns false if the timeout expires.
+static bool prv_sem_take(rtos_sem_t *sem, size_t timeout) {
+    USAGE_ASSERT(sem != NULL, "Passed NULL semaphore");
+    if (sem->count > 0) {
+        --sem->count;
+    } else if (timeout == 0) {
+        return false;
+    } else {
+        assert_can_block();
+        ASSERT(state.curr_task->state == RTOS_TASKSTATE_RUNNING);
+        state.curr_task->state = RTOS_TASKSTATE_WAIT_SEM;
+        plist_insert(&sem->waiting, state.curr_task);
+        wait_start_timeout(sem, timeout);
+        pend_context_switch();
+    }
+    return true;
+}
+
+static bool event_flags_satisfy(uint32_t flags, uint32_t wanted,
+                                uint32_t options)
+{
+    if (options & RTOS_EVENT_WAIT_ALL) {
+        return (flags & wanted) == wanted;
+    }
+    return (flags & wanted) != 0;
+}
+
+// Wakes every waiter that the new flags satisfy in one pass over the list.
+// Flags that waiters clear on exit are only cleared once the pass is done so
+// that every waiter sees the same flags.
+static void prv_event_group_set(rtos_event_group_t *group, uint32_t flags) {
+    USAGE_ASSERT(group != NULL, "Passed NULL event group");
+    const uint32_t new_flags = group->flags | flags;
+    uint32_t to_clear = 0;
+    rtos_tcb_t *task = group->waiting.head;
+    while (task != NULL) {
+        rtos_tcb_t *const next = task->next;
+        ASSERT(task->state == RTOS_TASKSTATE_WAIT_EVENT);
+        if (event_flags_satisfy(new_flags, task->wait_flags,
+                                task->wait_options))
+        {
+            if (task->wait_options & RTOS_EVENT_CLEAR_ON_EXIT) {
+                to_clear |= task->wait_flags;
+            }
+            *task->syscall_result = new_flags;
+            tlist_remove(&group->waiting, task);
+            make_task_ready(task);
+        }
+        task = next;
+    }
+    group->flags = new_flags & ~to_clear;
+    select_notify(group->select, group);
+}
+
+static void prv_event_group_clear(rtos_event_group_t *group, uint32_t flags) {
+    USAGE_ASSERT(group != NULL, "Passed NULL event group");
+    group->flags &= ~flags;
+}
+
+// Returns the flags that satisfied the wait, or 0 if the timeout expires.
+static uint32_t prv_event_group_wait(rtos_event_group_t *group, uint32_t flags,
+                                     uint32_t options, size_t timeout)
+{
+    USAGE_ASSERT(group != NULL, "Passed NULL event group");
+    USAGE_ASSERT(flags != 0, "Must wait for at least one flag");
+    const uint32_t current = group->flags;
+    if (event_flags_satisfy(current, flags, options)) {
+        if (options & RTOS_EVENT_CLEAR_ON_EXIT) {
+            group->flags = current & ~flags;
+        }
+        return current;
+    } else if (timeout != 0) {
+        assert_can_block();
+        ASSERT(state.curr_task->state == RTOS_TASKSTATE_RUNNING);
+        state.curr_task->state = RTOS_TASKSTATE_WAIT_EVENT;
+        state.curr_task->wait_flags = flags;
+        state.curr_task->wait_options = options;
+        tlist_push_back(&group->waiting, state.curr_task);
+        wait_start_timeout(group, timeout);
+        pend_context_switch();
+    }
+    return 0;
+}
+
+// Blocks the consumer unless the producer wrote to the ring since the consumer
+// last found it empty.
+static void prv_ring_wait(rtos_ring_t *ring) {
+    USAGE_ASSERT(ring != NULL, "Passed NULL ring");
+    USAGE_ASSERT(state.is_started, "RTOS must be started before calling");
+    USAGE_ASSERT(ring->consumer == NULL, "Ring already has a waiting task");
+    if (ring_is_empty(ring)) {
+        assert_can_block();
         ASSERT(state.curr_task->state == RTOS_TASKSTATE_RUNNING);
-        state.curr_task->state = RTOS_TASKSTATE_WAIT_DEQUEUE;
-        tlist_push_back(&mqueue->waiting, state.curr_task);
-        state.curr_task->mqueue_data = data;
+        state.curr_task->state = RTOS_TASKSTATE_WAIT_RING;
+        ring->consumer = state.curr_task;
         pend_context_switch();
     }
 }
 
+static void prv_ring_wake(rtos_ring_t *ring) {
+    rtos_tcb_t *const consumer = ring->consumer;
+    if (consumer != NULL) {
+        ASSERT(consumer->state == RTOS_TASKSTATE_WAIT_RING);
+        ring->consumer = NULL;
+        make_task_ready(consumer);
+    }
+}
+
 /* ----------------------------------------------------------------------------
  * Interrupt handlers
  * ------------------------------------------------------------------------- */
 
-[[gnu::used]] static void svc_handler_main(exception_entry_stack_t *stack) {
-    // The SVC number is encoded in the low byte of the SVC instruction. To
-    // access it, the PC saved on the stack during exception entry is used.
-    const int svc_num = ((uint8_t *)stack->pc)[-2];
-    size_t rv = 0;
-    switch (svc_num) {
-        case 0:
-            prv_start();
-            break;
-        case 1:
-            prv_task_create((rtos_tcb_t *)stack->r0,
-                            (const rtos_task_settings_t *)stack->r1);
-            break;
-        case 2:
-            rv = (size_t)prv_task_self();
-            break;
-        case 3:
-            prv_task_exit();
-            break;
-        case 4:
-            prv_task_yield();
-            break;
-        case 5:
-            prv_task_sleep(stack->r0);
-            break;
-        case 6:
-            prv_task_suspend();
-            break;
-        case 7:
-            prv_task_resume((void *)stack->r0);
-            break;
-        case 8:
-            prv_task_join((void *)stack->r0);
-            break;
-        case 9:
-            prv_mutex_create((void *)stack->r0, stack->r1);
-            break;
-        case 10:
-            prv_mutex_destroy((void *)stack->r0);
-            break;
-        case 11:
-            prv_mutex_lock((void *)stack->r0);
-            break;
-        case 12:
-            rv = prv_mutex_trylock((void *)stack->r0);
-            break;
-        case 13:
-            prv_mutex_unlock((void *)stack->r0);
-            break;
-        case 14:
-            prv_cond_create((void *)stack->r0);
-            break;
-        case 15:
-            prv_cond_destroy((void *)stack->r0);
-            break;
-        case 16:
-            prv_cond_wait((void *)stack->r0, (void *)stack->r1);
-            break;
-        case 17:
-            prv_cond_signal((void *)stack->r0);
-            break;
-        case 18:
-            prv_cond_broadcast((void *)stack->r0);
-            break;
-        case 19:
-            prv_mqueue_create((void *)stack->r0, (void *)stack->r1, stack->r2,
-                              stack->r3);
-            break;
-        case 20:
-            prv_mqueue_destroy((void *)stack->r0);
-            break;
-        case 21:
-            prv_mqueue_enqueue((void *)stack->r0, (void *)stack->r1);
-            break;
-        case 22:
-            prv_mqueue_dequeue((void *)stack->r0, (void *)stack->r1);
-            break;
-        default:
+// Adapts a prv_* implementation to the system call table's signature.
+#define syscall_handler(name) \
+    static size_t name(const exception_entry_stack_t *frame, \
+                       const size_t *stack_args)
+
+syscall_handler(sys_start) {
+    prv_start();
+    return 0;
+}
+
+syscall_handler(sys_task_create) {
+    return prv_task_create((rtos_tcb_t *)frame->r0,
+                           (const rtos_task_settings_t *)frame->r1);
+}
+
+syscall_handler(sys_task_exit) {
+    prv_task_exit();
+    return 0;
+}
+
+syscall_handler(sys_task_yield) {
+    prv_task_yield();
+    return 0;
+}
+
+syscall_handler(sys_task_sleep) {
+    prv_task_sleep(frame->r0);
+    return 0;
+}
+
+syscall_handler(sys_task_suspend) {
+    prv_task_suspend();
+    return 0;
+}
+
+syscall_handler(sys_task_resume) {
+    prv_task_resume((void *)frame->r0);
+    return 0;
+}
+
+syscall_handler(sys_task_join) {
+    prv_task_join((void *)frame->r0);
+    return 0;
+}
+
+syscall_handler(sys_mutex_create) {
+    prv_mutex_create((void *)frame->r0, frame->r1);
+    return 0;
+}
+
+syscall_handler(sys_mutex_destroy) {
+    prv_mutex_destroy((void *)frame->r0);
+    return 0;
+}
+
+syscall_handler(sys_mutex_lock) {
+    prv_mutex_lock((void *)frame->r0);
+    return 0;
+}
+
+syscall_handler(sys_mutex_trylock) {
+    return prv_mutex_trylock((void *)frame->r0);
+}
+
+syscall_handler(sys_mutex_unlock) {
+    prv_mutex_unlock((void *)frame->r0);
+    return 0;
+}
+
+syscall_handler(sys_cond_create) {
+    prv_cond_create((void *)frame->r0);
+    return 0;
+}
+
+syscall_handler(sys_cond_destroy) {
+    prv_cond_destroy((void *)frame->r0);
+    return 0;
+}
+
+syscall_handler(sys_cond_wait) {
+    prv_cond_wait((void *)frame->r0, (void *)frame->r1);
+    return 0;
+}
+
+syscall_handler(sys_cond_signal) {
+    prv_cond_signal((void *)frame->r0);
+    return 0;
+}
+
+syscall_handler(sys_cond_broadcast) {
+    prv_cond_broadcast((void *)frame->r0);
+    return 0;
+}
+
+syscall_handler(sys_mqueue_create) {
+    prv_mqueue_create((void *)frame->r0, (void *)frame->r1, frame->r2,
+                      frame->r3);
+    return 0;
+}
+
+syscall_handler(sys_mqueue_destroy) {
+    prv_mqueue_destroy((void *)frame->r0);
+    return 0;
+}
+
+syscall_handler(sys_mqueue_enqueue) {
+    prv_mqueue_enqueue((void *)frame->r0, (void *)frame->r1);
+    return 0;
+}
+
+syscall_handler(sys_mqueue_dequeue) {
+    prv_mqueue_dequeue((void *)frame->r0, (void *)frame->r1);
+    return 0;
+}
+
+syscall_handler(sys_task_sleep_until) {
+    prv_task_sleep_until((void *)frame->r0, frame->r1);
+    return 0;
+}
+
+syscall_handler(sys_task_get_stats) {
+    prv_task_get_stats((void *)frame->r0, (void *)frame->r1);
+    return 0;
+}
+
+#if RTOS_ENABLE_DEFERRED_WORK
+syscall_handler(sys_work_take) {
+    return (size_t)prv_work_take();
+}
+#endif
+
+#if RTOS_ENABLE_MUTEX_FAST_PATH
+syscall_handler(sys_task_reschedule) {
+    prv_task_reschedule();
+    return 0;
+}
+#endif
+
+syscall_handler(sys_ring_wait) {
+    prv_ring_wait((void *)frame->r0);
+    return 0;
+}
+
+syscall_handler(sys_ring_wake) {
+    prv_ring_wake((void *)frame->r0);
+    return 0;
+}
+
+syscall_handler(sys_mqueue_reserve) {
+    prv_mqueue_reserve((void *)frame->r0);
+    return 0;
+}
+
+syscall_handler(sys_mqueue_commit) {
+    prv_mqueue_commit((void *)frame->r0);
+    return 0;
+}
+
+syscall_handler(sys_mqueue_acquire) {
+    prv_mqueue_acquire((void *)frame->r0);
+    return 0;
+}
+
+syscall_handler(sys_mqueue_release) {
+    prv_mqueue_release((void *)frame->r0);
+    return 0;
+}
+
+syscall_handler(sys_task_join_timed) {
+    return prv_task_join_timed((void *)frame->r0, frame->r1);
+}
+
+syscall_handler(sys_mutex_lock_timed) {
+    return prv_mutex_lock_timed((void *)frame->r0, frame->r1);
+}
+
+syscall_handler(sys_cond_wait_timed) {
+    return prv_cond_wait_timed((void *)frame->r0, (void *)frame->r1,
+                               frame->r2);
+}
+
+syscall_handler(sys_mqueue_enqueue_timed) {
+    return prv_mqueue_enqueue_n((void *)frame->r0, (void *)frame->r1, 1, 1,
+                                frame->r2);
+}
+
+syscall_handler(sys_mqueue_dequeue_timed) {
+    return prv_mqueue_dequeue_n((void *)frame->r0, (void *)frame->r1, 1, 1,
+                                frame->r2);
+}
+
+syscall_handler(sys_sem_give) {
+    return prv_sem_give((void *)frame->r0);
+}
+
+syscall_handler(sys_sem_take) {
+    return prv_sem_take((void *)frame->r0, frame->r1);
+}
+
+syscall_handler(sys_event_group_set) {
+    prv_event_group_set((void *)frame->r0, frame->r1);
+    return 0;
+}
+
+syscall_handler(sys_task_notify) {
+    return prv_task_notify((void *)frame->r0, frame->r1, frame->r2);
+}
+
+syscall_handler(sys_task_notify_wait) {
+    return prv_task_notify_wait(frame->r0);
+}
+
+syscall_handler(sys_select_wait) {
+    return prv_select_wait((void *)frame->r0, frame->r1);
+}
+
+syscall_handler(sys_rwlock_read_lock) {
+    prv_rwlock_read_lock((void *)frame->r0);
+    return 0;
+}
+
+syscall_handler(sys_rwlock_read_unlock) {
+    prv_rwlock_read_unlock((void *)frame->r0);
+    return 0;
+}
+
+syscall_handler(sys_rwlock_write_lock) {
+    prv_rwlock_write_lock((void *)frame->r0);
+    return 0;
+}
+
+syscall_handler(sys_rwlock_write_unlock) {
+    prv_rwlock_write_unlock((void *)frame->r0);
+    return 0;
+}
+
+syscall_handler(sys_mutex_create_inherit) {
+    prv_mutex_create_inherit((void *)frame->r0);
+    return 0;
+}
+
+syscall_handler(sys_event_group_clear) {
+    prv_event_group_clear((void *)frame->r0, frame->r1);
+    return 0;
+}
+
+syscall_handler(sys_event_group_wait) {
+    return prv_event_group_wait((void *)frame->r0, frame->r1, frame->r2,
+                                frame->r3);
+}
+
+syscall_handler(sys_stream_send) {
+    prv_stream_send((void *)frame->r0, (void *)frame->r1, frame->r2);
+    return 0;
+}
+
+syscall_handler(sys_stream_receive) {
+    return prv_stream_receive((void *)frame->r0, (void *)frame->r1,
+                              frame->r2);
+}
+
+syscall_handler(sys_msgbuf_discard) {
+    return prv_msgbuf_discard((void *)frame->r0);
+}
+
+syscall_handler(sys_mqueue_enqueue_n) {
+    return prv_mqueue_enqueue_n((void *)frame->r0, (void *)frame->r1,
+                                frame->r2, frame->r3, RTOS_WAIT_FOREVER);
+}
+
+syscall_handler(sys_mqueue_dequeue_n) {
+    return prv_mqueue_dequeue_n((void *)frame->r0, (void *)frame->r1,
+                                frame->r2, frame->r3, RTOS_WAIT_FOREVER);
+}
+
+// The timeout is the fifth argument, so the caller passes it on its stack
+syscall_handler(sys_mqueue_enqueue_n_timed) {
+    return prv_mqueue_enqueue_n((void *)frame->r0, (void *)frame->r1,
+                                frame->r2, frame->r3, stack_args[0]);
+}
+
+syscall_handler(sys_mqueue_dequeue_n_timed) {
+    return prv_mqueue_dequeue_n((void *)frame->r0, (void *)frame->r1,
+                                frame->r2, frame->r3, stack_args[0]);
+}
+
+// Every system call and its handler. Calls that are disabled by the
+// configuration are listed separately.
+#define SYSCALL_LIST(X)                                           \
+    X(SYSCALL_START, sys_start)                                   \
+    X(SYSCALL_TASK_CREATE, sys_task_create)                       \
+    X(SYSCALL_TASK_EXIT, sys_task_exit)                           \
+    X(SYSCALL_TASK_YIELD, sys_task_yield)                         \
+    X(SYSCALL_TASK_SLEEP, sys_task_sleep)                         \
+    X(SYSCALL_TASK_SUSPEND, sys_task_suspend)                     \
+    X(SYSCALL_TASK_RESUME, sys_task_resume)                       \
+    X(SYSCALL_TASK_JOIN, sys_task_join)                           \
+    X(SYSCALL_MUTEX_CREATE, sys_mutex_create)                     \
+    X(SYSCALL_MUTEX_DESTROY, sys_mutex_destroy)                   \
+    X(SYSCALL_MUTEX_LOCK, sys_mutex_lock)                         \
+    X(SYSCALL_MUTEX_TRYLOCK, sys_mutex_trylock)                   \
+    X(SYSCALL_MUTEX_UNLOCK, sys_mutex_unlock)                     \
+    X(SYSCALL_COND_CREATE, sys_cond_create)                       \
+    X(SYSCALL_COND_DESTROY, sys_cond_destroy)                     \
+    X(SYSCALL_COND_WAIT, sys_cond_wait)                           \
+    X(SYSCALL_COND_SIGNAL, sys_cond_signal)                       \
+    X(SYSCALL_COND_BROADCAST, sys_cond_broadcast)                 \
+    X(SYSCALL_MQUEUE_CREATE, sys_mqueue_create)                   \
+    X(SYSCALL_MQUEUE_DESTROY, sys_mqueue_destroy)                 \
+    X(SYSCALL_MQUEUE_ENQUEUE, sys_mqueue_enqueue)                 \
+    X(SYSCALL_MQUEUE_DEQUEUE, sys_mqueue_dequeue)                 \
+    X(SYSCALL_TASK_SLEEP_UNTIL, sys_task_sleep_until)             \
+    X(SYSCALL_TASK_GET_STATS, sys_task_get_stats)                 \
+    X(SYSCALL_RING_WAIT, sys_ring_wait)                           \
+    X(SYSCALL_RING_WAKE, sys_ring_wake)                           \
+    X(SYSCALL_MQUEUE_RESERVE, sys_mqueue_reserve)                 \
+    X(SYSCALL_MQUEUE_COMMIT, sys_mqueue_commit)                   \
+    X(SYSCALL_MQUEUE_ACQUIRE, sys_mqueue_acquire)                 \
+    X(SYSCALL_MQUEUE_RELEASE, sys_mqueue_release)                 \
+    X(SYSCALL_MQUEUE_ENQUEUE_N, sys_mqueue_enqueue_n)             \
+    X(SYSCALL_MQUEUE_DEQUEUE_N, sys_mqueue_dequeue_n)             \
+    X(SYSCALL_STREAM_SEND, sys_stream_send)                       \
+    X(SYSCALL_STREAM_RECEIVE, sys_stream_receive)                 \
+    X(SYSCALL_TASK_JOIN_TIMED, sys_task_join_timed)               \
+    X(SYSCALL_MUTEX_LOCK_TIMED, sys_mutex_lock_timed)             \
+    X(SYSCALL_COND_WAIT_TIMED, sys_cond_wait_timed)               \
+    X(SYSCALL_MQUEUE_ENQUEUE_TIMED, sys_mqueue_enqueue_timed)     \
+    X(SYSCALL_MQUEUE_DEQUEUE_TIMED, sys_mqueue_dequeue_timed)     \
+    X(SYSCALL_SEM_GIVE, sys_sem_give)                             \
+    X(SYSCALL_SEM_TAKE, sys_sem_take)                             \
+    X(SYSCALL_EVENT_GROUP_SET, sys_event_group_set)               \
+    X(SYSCALL_EVENT_GROUP_CLEAR, sys_event_group_clear)           \
+    X(SYSCALL_EVENT_GROUP_WAIT, sys_event_group_wait)             \
+    X(SYSCALL_TASK_NOTIFY, sys_task_notify)                       \
+    X(SYSCALL_TASK_NOTIFY_WAIT, sys_task_notify_wait)             \
+    X(SYSCALL_SELECT_WAIT, sys_select_wait)                       \
+    X(SYSCALL_RWLOCK_READ_LOCK, sys_rwlock_read_lock)             \
+    X(SYSCALL_RWLOCK_READ_UNLOCK, sys_rwlock_read_unlock)         \
+    X(SYSCALL_RWLOCK_WRITE_LOCK, sys_rwlock_write_lock)           \
+    X(SYSCALL_RWLOCK_WRITE_UNLOCK, sys_rwlock_write_unlock)       \
+    X(SYSCALL_MUTEX_CREATE_INHERIT, sys_mutex_create_inherit)     \
+    X(SYSCALL_MSGBUF_DISCARD, sys_msgbuf_discard)                 \
+    X(SYSCALL_MQUEUE_ENQUEUE_N_TIMED, sys_mqueue_enqueue_n_timed) \
+    X(SYSCALL_MQUEUE_DEQUEUE_N_TIMED, sys_mqueue_dequeue_n_timed) \
+    SYSCALL_LIST_WORK(X)                                          \
+    SYSCALL_LIST_MUTEX_FAST_PATH(X)
+
+#if RTOS_ENABLE_DEFERRED_WORK
+#define SYSCALL_LIST_WORK(X) X(SYSCALL_WORK_TAKE, sys_work_take)
+#else
+#define SYSCALL_LIST_WORK(X)
+#endif
+
+#if RTOS_ENABLE_MUTEX_FAST_PATH
+#define SYSCALL_LIST_MUTEX_FAST_PATH(X) \
+    X(SYSCALL_TASK_RESCHEDULE, sys_task_reschedule)
+#else
+#define SYSCALL_LIST_MUTEX_FAST_PATH(X)
+#endif
+
+static size_t syscall_invalid(const exception_entry_stack_t *frame,
+                              size_t num)
+{
 #ifdef RTOS_DEBUG
-            size_t debug_syscall(void *, int);
-            rv = debug_syscall((void *)stack->r0, svc_num);
+    size_t debug_syscall(void *, int);
+    return debug_syscall((void *)frame->r0, num);
 #else // ifdef RTOS_DEBUG
-            USAGE_ASSERT(false, "Invalid SVC number");
+    USAGE_ASSERT(false, "Invalid system call number");
+    return 0;
 #endif // ifdef RTOS_DEBUG
-            break;
+}
+
+#if RTOS_ENABLE_SYSCALL_TABLE
+
+#define SYSCALL_TABLE_ENTRY(num, handler) [num] = handler,
+
+// Entries for system calls that are disabled by the configuration are NULL.
+static const syscall_func_t syscall_table[SYSCALL_COUNT] = {
+    SYSCALL_LIST(SYSCALL_TABLE_ENTRY)
+};
+
+static size_t syscall_run(size_t num, const exception_entry_stack_t *frame,
+                          const size_t *stack_args)
+{
+    if (num < SYSCALL_COUNT && syscall_table[num] != NULL) {
+        return syscall_table[num](frame, stack_args);
+    }
+    return syscall_invalid(frame, num);
+}
+
+#else // #if RTOS_ENABLE_SYSCALL_TABLE
+
+#define SYSCALL_CASE(num, handler) \
+    case num:                       \
+        return handler(frame, stack_args);
+
+static size_t syscall_run(size_t num, const exception_entry_stack_t *frame,
+                          const size_t *stack_args)
+{
+    switch (num) {
+        SYSCALL_LIST(SYSCALL_CASE)
+        default:
+            return syscall_invalid(frame, num);
+    }
+}
+
+#endif // #if RTOS_ENABLE_SYSCALL_TABLE
+
+// Runs a system call and stores the return value in the frame's R0.
+[[gnu::used]] static void syscall_dispatch(exception_entry_stack_t *frame,
+                                           const size_t *stack_args,
+                                           size_t num)
+{
+    const uint32_t basepri = kernel_lock();
+    const size_t rv = syscall_run(num, frame, stack_args);
+    kernel_unlock(basepri);
+    frame->r0 = rv;
+}
+
+[[gnu::used]] static void svc_handler_main(exception_entry_stack_t *frame,
+                                           uint32_t exc_return)
+{
+#if RTOS_ENABLE_SYSCALL_TABLE
+    const size_t num = frame->r12;
+#else
+    // The number is encoded in the low byte of the SVC instruction. To access
+    // it, the PC saved on the stack during exception entry is used.
+    const size_t num = ((const uint8_t *)frame->pc)[-2];
+#endif
+
+    // A task that blocks gets its result from whoever ends the wait, which
+    // stores it in the same place after the handler has returned. Only a task
+    // can block, so calls made from handler mode don't touch it.
+    if ((exc_return & cm4_exc_return_thread_mask) && state.curr_task != NULL) {
+        state.curr_task->syscall_result = &frame->r0;
     }
 
-    // Store the return value in the part of the stack that gets popped to R0
-    // when the handler returns.
-    stack->r0 = rv;
+    // Storing the return value in the frame means it gets popped to R0 when
+    // the handler returns.
+    syscall_dispatch(frame, syscall_stack_args(frame, exc_return), num);
 }
 
 [[gnu::naked]] void SVC_Handler(void) {
@@ -487,14 +2153,42 @@ static void prv_mqueue_dequeue(rtos_mqueue_t *mqueue, void *data) {
     "   ite     eq                  \n"
     "   mrseq   r0, msp             \n"
     "   mrsne   r0, psp             \n"
+    "   mov     r1, lr              \n"
     "   b       svc_handler_main    \n"
     );
 }
 
+#if RTOS_ENABLE_SYSCALL_TABLE
+
+// Called instead of trapping when a system call is made from handler mode.
+// The arguments are stacked in the same layout as an exception frame so that
+// the call is dispatched the same way. The system call number is in R12.
+[[gnu::naked, gnu::used]] static void syscall_direct(void) {
+    __asm volatile(
+    "   sub     sp, #8              \n" // Unused PC and xPSR
+    "   push    {r0-r3, r12, lr}    \n"
+    "   mov     r0, sp              \n"
+    "   add     r1, sp, #32         \n" // Stack arguments are above the frame
+    "   mov     r2, r12             \n"
+    "   bl      syscall_dispatch    \n"
+    "   ldr     r0, [sp, #0]        \n" // Return value
+    "   ldr     lr, [sp, #20]       \n"
+    "   add     sp, #32             \n"
+    "   bx      lr                  \n"
+    );
+}
+
+#endif // #if RTOS_ENABLE_SYSCALL_TABLE
+
 // Returns a pointer to the next task's switch frame.
 [[gnu::used]] static stack_frame_switch_t *choose_next_task(
     stack_frame_switch_t *old_switch_frame)
 {
+#ifdef RTOS_DEBUG
+    void debug_context_switch(void);
+    debug_context_switch();
+#endif
+
     if (state.curr_task != NULL) {
         USAGE_ASSERT((size_t)old_switch_frame >=
                          (size_t)state.curr_task->stack_low,
@@ -507,29 +2201,55 @@ static void prv_mqueue_dequeue(rtos_mqueue_t *mqueue, void *data) {
     rtos_tcb_t *const next_task = tpq_pop_front(&state.ready_tasks) 
                                     ?: &state.idle_task;
 
+#if RTOS_ENABLE_TICKLESS_IDLE
+    if (next_task == &state.idle_task) {
+        tickless_suppress_ticks();
+    } else if (state.suppressed_ticks != 0) {
+        tickless_resume_ticks();
+    }
+#endif
+
     size_t control = cm4_get_control();
-    if (next_task->privileged) {
+    if (!next_task->privileged) {
         control |= cm4_control_npriv_mask;
     } else {
         control &= ~cm4_control_npriv_mask;
     }
     cm4_set_control(control);
 
+    // Record how long a periodic task waited to run after being released.
+    if (next_task->period != 0 && !next_task->job_started) {
+        const size_t jitter = state.tick_count - next_task->release_time;
+        if (jitter > next_task->stats.max_release_jitter) {
+            next_task->stats.max_release_jitter = jitter;
+        }
+        next_task->job_started = true;
+    }
+
     ASSERT(next_task->state == RTOS_TASKSTATE_READY);
     next_task->state = RTOS_TASKSTATE_RUNNING;
     state.is_preempting = false;
     state.curr_task = next_task;
+
+    info_write_begin();
+    ++next_task->counters.activations;
+    ++state.info.epoch;
+    state.info.curr_task = next_task;
+    info_write_end();
     return next_task->switch_frame;
 }
 
-// Interrupts are disabled during this to ensure an atomic context switch. This
-// is needed because PendSV has the lowest priority and otherwise, another
-// interrupt could pre-empt this handler and call a kernel function while the
-// kernel state is invalid.
+// Interrupts that may call the kernel are masked during this to ensure an
+// atomic context switch. This is needed because PendSV has the lowest priority
+// and otherwise, another interrupt could pre-empt this handler and call a
+// kernel function while the kernel state is invalid. Interrupts above
+// RTOS_MAX_SYSCALL_IRQ_PRIORITY can still pre-empt it.
 static_assert(NULL == 0, "Assembly assumes NULL == 0");
 [[gnu::naked]] void PendSV_Handler(void) {
     __asm volatile(
-    "   cpsid       i               \n" // Disable interrupts
+    "   mov         r0, %0          \n"
+    "   msr         basepri, r0     \n" // Mask kernel interrupts
+    "   isb                         \n"
     "                               \n"
     "   ldr         r1, =state      \n" // r1 = &state
     "                               \n"
@@ -547,6 +2267,7 @@ static_assert(NULL == 0, "Assembly assumes NULL == 0");
     "   str         lr, [r0]        \n" // Save EXC_RETURN
     "                               \n"
     "no_save:                       \n"
+    "   clrex                       \n" // Fail the old task's pending STREX
     "   bl          choose_next_task\n" // r0 = choose_next_task(r0)
     "   ldr         lr, [r0]        \n" // Restore EXC_RETURN
     "   add         r0, #4          \n"
@@ -564,8 +2285,10 @@ static_assert(NULL == 0, "Assembly assumes NULL == 0");
     "   msr         psp, r0         \n" // Update the PSP
     "   msr         control, r1     \n" // Update CONTROL
     "                               \n"
-    "   cpsie       i               \n" // Re-enable interrupts
+    "   mov         r1, #0          \n"
+    "   msr         basepri, r1     \n" // Unmask kernel interrupts
     "   bx          lr              \n"
+    : : "i"(KERNEL_BASEPRI)
     );
 }
 
@@ -574,15 +2297,34 @@ void rtos_tick(void) {
         return;
     }
 
-    ++state.tick_count;
-    --state.curr_task->slice_left;
+    const uint32_t basepri = kernel_lock();
+
+#if RTOS_ENABLE_TICKLESS_IDLE
+    if (state.suppressed_ticks != 0) {
+        // A tickless period has elapsed. None of the suppressed ticks had any
+        // work to do so the tick count can be caught up all at once. Only the
+        // final tick is charged to the current task's time slice.
+        *cm4_syst_rvr = state.cycles_per_tick - 1;
+        *cm4_syst_cvr = 0;
+        tick_count_advance(state.suppressed_ticks - 1);
+        state.suppressed_ticks = 0;
+    }
+#endif
+
+    tick_count_advance(1);
+
+    if (state.curr_task->budget != 0) {
+        budget_charge(state.curr_task);
+    }
 
     bool context_switch_required = false;
     bool push_to_back = false;
 
     // Check if the current task's time slice expired.
-    if (state.curr_task->slice_left == 0) {
-        state.curr_task->slice_left = RTOS_TICKS_PER_SLICE;
+    if (tcb_is_time_sliced(state.curr_task) &&
+        --state.curr_task->slice_left == 0)
+    {
+        tcb_reset_slice(state.curr_task);
         if (!tpq_list_is_empty(&state.ready_tasks, state.curr_task)) {
             context_switch_required = true;
             push_to_back = true;
@@ -590,21 +2332,31 @@ void rtos_tick(void) {
     }
 
     // Check if there are any sleeping tasks to wake.
-    while (!tlist_is_empty(&state.sleeping_tasks) &&
-           state.sleeping_tasks.head->wake_time <= state.tick_count)
-    {
-        rtos_tcb_t *const waken = tlist_pop_front(&state.sleeping_tasks);
-        ASSERT(waken->state == RTOS_TASKSTATE_SLEEPING);
+    wheel_advance(&state.sleeping_tasks, state.tick_count);
+    rtos_timer_t *timer;
+    while ((timer = wheel_pop_expired(&state.sleeping_tasks)) != NULL) {
+        rtos_tcb_t *const waken = tcb_from_timer(timer);
+        if (waken->state == RTOS_TASKSTATE_THROTTLED) {
+            budget_replenish(waken);
+        } else if (waken->state == RTOS_TASKSTATE_SLEEPING) {
+            release_task(waken);
+        } else if (!wait_time_out(waken)) {
+            continue;
+        }
         waken->state = RTOS_TASKSTATE_READY;
         tpq_push_back(&state.ready_tasks, waken);
+    }
 
-        // Check if the waken task preempts the current task.
-        if (waken->priority > state.curr_task->priority) {
-            context_switch_required = true;
-        }
+    // Check if any waken task preempts the current task.
+    if (tpq_has_higher(&state.ready_tasks, state.curr_task)) {
+        context_switch_required = true;
     }
 
-    if (context_switch_required) {
+    // The current task may have already blocked or been preempted with the
+    // context switch still pending, in which case it's no longer running.
+    if (context_switch_required &&
+        state.curr_task->state == RTOS_TASKSTATE_RUNNING)
+    {
         state.curr_task->state = RTOS_TASKSTATE_READY;
         if (push_to_back) {
             tpq_push_back(&state.ready_tasks, state.curr_task);
@@ -613,54 +2365,838 @@ void rtos_tick(void) {
         }
         pend_context_switch();
     }
+
+#if RTOS_ENABLE_TICKLESS_IDLE
+    // If the idle task keeps running, ticks can be suppressed again.
+    if (state.curr_task == &state.idle_task &&
+        tpq_is_empty(&state.ready_tasks))
+    {
+        tickless_suppress_ticks();
+    }
+#endif
+
+    kernel_unlock(basepri);
 }
 
 /* ----------------------------------------------------------------------------
  * Public API implementations
  * ------------------------------------------------------------------------- */
 
-// Macro for SVC wrapper function implementations.
+#if RTOS_ENABLE_USAGE_ASSERT
+
+// A critical section's BASEPRI masks SVC, so a system call made from thread
+// mode inside one would escalate to a HardFault. The wrappers check for it
+// before trapping so that it fails a usage assertion instead.
+[[gnu::used, noreturn]] static void syscall_in_critical(void) {
+    USAGE_ASSERT(false, "System call made inside a critical section");
+    while (true) {}
+}
+
+#define SVCCALL_CHECK_CRITICAL                      \
+        "   movw    r12, #:lower16:state \n"        \
+        "   movt    r12, #:upper16:state \n"        \
+        "   ldr     r12, [r12, %1]      \n"         \
+        "   cmp     r12, #0             \n"         \
+        "   bne     syscall_in_critical \n"
+
+#else // #if RTOS_ENABLE_USAGE_ASSERT
+
+#define SVCCALL_CHECK_CRITICAL
+
+#endif // #if RTOS_ENABLE_USAGE_ASSERT
+
+#if RTOS_ENABLE_SYSCALL_TABLE
+
+// Macro for system call wrapper function implementations. IPSR is non-zero in
+// handler mode, where the call is made directly instead of trapping.
+#define svccall(num, name, ret, ...) \
+    [[gnu::naked]] ret name(__VA_ARGS__) {          \
+        __asm volatile(                             \
+        "   mrs     r12, ipsr           \n"         \
+        "   cmp     r12, #0             \n"         \
+        "   mov     r12, %0             \n"         \
+        "   beq     1f                  \n"         \
+        "   b       syscall_direct      \n"         \
+        "1:                             \n"         \
+        SVCCALL_CHECK_CRITICAL                      \
+        "   mov     r12, %0             \n"         \
+        "   svc     0                   \n"         \
+        "   bx      lr                  \n"         \
+        : : "i"(num),                               \
+            "i"(offsetof(rtos_state_t, critical_nesting)) \
+        );                                          \
+    }
+
+#else // #if RTOS_ENABLE_SYSCALL_TABLE
+
 #define svccall(num, name, ret, ...) \
     [[gnu::naked]] ret name(__VA_ARGS__) {          \
         __asm volatile(                             \
-        "   svc    "#num"   \n"                     \
-        "   bx      lr      \n"                     \
+        SVCCALL_CHECK_CRITICAL                      \
+        "   svc     %0                  \n"         \
+        "   bx      lr                  \n"         \
+        : : "i"(num),                               \
+            "i"(offsetof(rtos_state_t, critical_nesting)) \
         );                                          \
     }
 
-svccall(0,  rtos_start,         void,   void)
-svccall(1,  rtos_task_create,   void,   rtos_tcb_t *task,
+#endif // #if RTOS_ENABLE_SYSCALL_TABLE
+
+svccall(SYSCALL_START,          rtos_start,         void,   void)
+svccall(SYSCALL_TASK_CREATE,    rtos_task_create,   bool,   rtos_tcb_t *task,
                                         const rtos_task_settings_t *settings)
-svccall(2,  rtos_task_self,     rtos_tcb_t *, void)
-svccall(3,  rtos_task_exit,     void,   void)
-svccall(4,  rtos_task_yield,    void,   void)
-svccall(5,  rtos_task_sleep,    void,   size_t ticks)
-svccall(6,  rtos_task_suspend,  void,   void)
-svccall(7,  rtos_task_resume,   void,   rtos_tcb_t *task)
-svccall(8,  rtos_task_join,     void,   rtos_tcb_t *task)
-svccall(9,  rtos_mutex_create,  void,   rtos_mutex_t *mutex,
-                                        size_t priority_ceil)
-svccall(10, rtos_mutex_destroy, void,   rtos_mutex_t *task)
-svccall(11, rtos_mutex_lock,    void,   rtos_mutex_t *task)
-svccall(12, rtos_mutex_trylock, bool,   rtos_mutex_t *task)
-svccall(13, rtos_mutex_unlock,  void,   rtos_mutex_t *task)
-svccall(14, rtos_cond_create,   void,   rtos_cond_t *cond)
-svccall(15, rtos_cond_destroy,  void,   rtos_cond_t *cond)
-svccall(16, rtos_cond_wait,     void,   rtos_cond_t *cond,
-                                        rtos_mutex_t *mutex)
-svccall(17, rtos_cond_signal,   void,   rtos_cond_t *cond)
-svccall(18, rtos_cond_broadcast,void,   rtos_cond_t *cond)
-svccall(19, rtos_mqueue_create, void,   rtos_mqueue_t *mqueue, uint8_t *buffer,
-                                        size_t slots, size_t slot_size)
-svccall(20, rtos_mqueue_destroy,void,   rtos_mqueue_t *mqueue)
-svccall(21, rtos_mqueue_enqueue,void,   rtos_mqueue_t *mqueue,
-                                        const void *data)
-svccall(22, rtos_mqueue_dequeue,void,   rtos_mqueue_t *mqueue,
-                                        void *data)
+svccall(SYSCALL_TASK_EXIT,      rtos_task_exit,     void,   void)
+svccall(SYSCALL_TASK_YIELD,     rtos_task_yield,    void,   void)
+svccall(SYSCALL_TASK_SLEEP,     rtos_task_sleep,    void,   size_t ticks)
+svccall(SYSCALL_TASK_SUSPEND,   rtos_task_suspend,  void,   void)
+svccall(SYSCALL_TASK_RESUME,    rtos_task_resume,   void,   rtos_tcb_t *task)
+svccall(SYSCALL_TASK_JOIN,      rtos_task_join,     void,   rtos_tcb_t *task)
+svccall(SYSCALL_MUTEX_CREATE,   rtos_mutex_create,  void,   rtos_mutex_t *mutex,
+                                                    size_t priority_ceil)
+svccall(SYSCALL_MUTEX_DESTROY,  rtos_mutex_destroy, void,   rtos_mutex_t *task)
+#if !RTOS_ENABLE_MUTEX_FAST_PATH
+svccall(SYSCALL_MUTEX_LOCK,     rtos_mutex_lock,    void,   rtos_mutex_t *task)
+#endif
+svccall(SYSCALL_MUTEX_TRYLOCK,  rtos_mutex_trylock, bool,   rtos_mutex_t *task)
+#if !RTOS_ENABLE_MUTEX_FAST_PATH
+svccall(SYSCALL_MUTEX_UNLOCK,   rtos_mutex_unlock,  void,   rtos_mutex_t *task)
+#endif
+svccall(SYSCALL_COND_CREATE,    rtos_cond_create,   void,   rtos_cond_t *cond)
+svccall(SYSCALL_COND_DESTROY,   rtos_cond_destroy,  void,   rtos_cond_t *cond)
+svccall(SYSCALL_COND_WAIT,      rtos_cond_wait,     void,   rtos_cond_t *cond,
+                                                    rtos_mutex_t *mutex)
+svccall(SYSCALL_COND_SIGNAL,    rtos_cond_signal,   void,   rtos_cond_t *cond)
+svccall(SYSCALL_COND_BROADCAST, rtos_cond_broadcast,void,   rtos_cond_t *cond)
+svccall(SYSCALL_MQUEUE_CREATE,  rtos_mqueue_create, void,
+                                rtos_mqueue_t *mqueue, uint8_t *buffer,
+                                size_t slots, size_t slot_size)
+svccall(SYSCALL_MQUEUE_DESTROY, rtos_mqueue_destroy,void,
+                                rtos_mqueue_t *mqueue)
+svccall(SYSCALL_MQUEUE_ENQUEUE, rtos_mqueue_enqueue,void,
+                                rtos_mqueue_t *mqueue, const void *data)
+svccall(SYSCALL_MQUEUE_DEQUEUE, rtos_mqueue_dequeue,void,
+                                rtos_mqueue_t *mqueue, void *data)
+svccall(SYSCALL_TASK_SLEEP_UNTIL,   rtos_task_sleep_until,  void,
+                                    size_t *last_wake, size_t period)
+svccall(SYSCALL_TASK_GET_STATS,     rtos_task_get_stats,    void,
+                                    const rtos_tcb_t *task,
+                                    rtos_task_stats_t *stats)
+
+static void ring_wait(rtos_ring_t *ring);
+static void ring_wake(rtos_ring_t *ring);
+
+svccall(SYSCALL_RING_WAIT,          ring_wait,              void,
+                                    rtos_ring_t *ring)
+svccall(SYSCALL_RING_WAKE,          ring_wake,              void,
+                                    rtos_ring_t *ring)
+
+static void mqueue_reserve(rtos_mqueue_t *mqueue);
+static void mqueue_acquire(rtos_mqueue_t *mqueue);
+
+svccall(SYSCALL_MQUEUE_RESERVE,     mqueue_reserve,         void,
+                                    rtos_mqueue_t *mqueue)
+svccall(SYSCALL_MQUEUE_COMMIT,      rtos_mqueue_commit,     void,
+                                    rtos_mqueue_t *mqueue)
+svccall(SYSCALL_MQUEUE_ACQUIRE,     mqueue_acquire,         void,
+                                    rtos_mqueue_t *mqueue)
+svccall(SYSCALL_MQUEUE_RELEASE,     rtos_mqueue_release,    void,
+                                    rtos_mqueue_t *mqueue)
+
+svccall(SYSCALL_MQUEUE_ENQUEUE_N,   rtos_mqueue_enqueue_n,  size_t,
+                                    rtos_mqueue_t *mqueue, const void *data,
+                                    size_t count, size_t min_count)
+svccall(SYSCALL_MQUEUE_DEQUEUE_N,   rtos_mqueue_dequeue_n,  size_t,
+                                    rtos_mqueue_t *mqueue, void *data,
+                                    size_t count, size_t min_count)
+svccall(SYSCALL_MQUEUE_ENQUEUE_N_TIMED, rtos_mqueue_enqueue_n_timed, size_t,
+                                    rtos_mqueue_t *mqueue, const void *data,
+                                    size_t count, size_t min_count,
+                                    size_t timeout)
+svccall(SYSCALL_MQUEUE_DEQUEUE_N_TIMED, rtos_mqueue_dequeue_n_timed, size_t,
+                                    rtos_mqueue_t *mqueue, void *data,
+                                    size_t count, size_t min_count,
+                                    size_t timeout)
+
+svccall(SYSCALL_STREAM_SEND,        rtos_stream_send,       void,
+                                    rtos_stream_t *stream, const void *data,
+                                    size_t len)
+svccall(SYSCALL_STREAM_RECEIVE,     rtos_stream_receive,    size_t,
+                                    rtos_stream_t *stream, void *data,
+                                    size_t max_len)
+
+static bool mutex_lock_timed(rtos_mutex_t *mutex, size_t timeout);
+
+svccall(SYSCALL_TASK_JOIN_TIMED,    rtos_task_join_timed,   bool,
+                                    rtos_tcb_t *task, size_t timeout)
+svccall(SYSCALL_MUTEX_LOCK_TIMED,   mutex_lock_timed,       bool,
+                                    rtos_mutex_t *mutex, size_t timeout)
+svccall(SYSCALL_COND_WAIT_TIMED,    rtos_cond_wait_timed,   bool,
+                                    rtos_cond_t *cond, rtos_mutex_t *mutex,
+                                    size_t timeout)
+svccall(SYSCALL_MQUEUE_ENQUEUE_TIMED, rtos_mqueue_enqueue_timed, bool,
+                                    rtos_mqueue_t *mqueue, const void *data,
+                                    size_t timeout)
+svccall(SYSCALL_MQUEUE_DEQUEUE_TIMED, rtos_mqueue_dequeue_timed, bool,
+                                    rtos_mqueue_t *mqueue, void *data,
+                                    size_t timeout)
+
+static bool sem_take(rtos_sem_t *sem, size_t timeout);
+
+svccall(SYSCALL_SEM_GIVE,           rtos_sem_give,          bool,
+                                    rtos_sem_t *sem)
+svccall(SYSCALL_SEM_TAKE,           sem_take,               bool,
+                                    rtos_sem_t *sem, size_t timeout)
+
+svccall(SYSCALL_EVENT_GROUP_SET,    rtos_event_group_set,   void,
+                                    rtos_event_group_t *group, uint32_t flags)
+svccall(SYSCALL_EVENT_GROUP_CLEAR,  rtos_event_group_clear, void,
+                                    rtos_event_group_t *group, uint32_t flags)
+svccall(SYSCALL_EVENT_GROUP_WAIT,   rtos_event_group_wait_timed, uint32_t,
+                                    rtos_event_group_t *group, uint32_t flags,
+                                    uint32_t options, size_t timeout)
+
+static bool task_notify_wait(size_t timeout);
+
+svccall(SYSCALL_TASK_NOTIFY,        rtos_task_notify,       bool,
+                                    rtos_tcb_t *task, uint32_t value,
+                                    rtos_notify_action_t action)
+svccall(SYSCALL_TASK_NOTIFY_WAIT,   task_notify_wait,       bool,
+                                    size_t timeout)
+
+static size_t select_wait(rtos_select_t *select, size_t timeout);
+
+svccall(SYSCALL_SELECT_WAIT,        select_wait,            size_t,
+                                    rtos_select_t *select, size_t timeout)
+
+svccall(SYSCALL_RWLOCK_READ_LOCK,   rtos_rwlock_read_lock,  void,
+                                    rtos_rwlock_t *rwlock)
+svccall(SYSCALL_RWLOCK_READ_UNLOCK, rtos_rwlock_read_unlock, void,
+                                    rtos_rwlock_t *rwlock)
+svccall(SYSCALL_RWLOCK_WRITE_LOCK,  rtos_rwlock_write_lock, void,
+                                    rtos_rwlock_t *rwlock)
+svccall(SYSCALL_RWLOCK_WRITE_UNLOCK, rtos_rwlock_write_unlock, void,
+                                    rtos_rwlock_t *rwlock)
+
+svccall(SYSCALL_MUTEX_CREATE_INHERIT, rtos_mutex_create_inherit, void,
+                                    rtos_mutex_t *mutex)
+
+svccall(SYSCALL_MSGBUF_DISCARD,     rtos_msgbuf_discard,    size_t,
+                                    rtos_msgbuf_t *msgbuf)
+
+#if RTOS_ENABLE_DEFERRED_WORK
+svccall(SYSCALL_WORK_TAKE,          work_take,              rtos_work_t *,
+                                    void)
+#endif
+
+#if RTOS_ENABLE_MUTEX_FAST_PATH
+
+static void mutex_lock_syscall(rtos_mutex_t *mutex);
+static void mutex_unlock_syscall(rtos_mutex_t *mutex);
+static void task_reschedule(void);
+
+svccall(SYSCALL_MUTEX_LOCK,         mutex_lock_syscall,     void,
+                                    rtos_mutex_t *mutex)
+svccall(SYSCALL_MUTEX_UNLOCK,       mutex_unlock_syscall,   void,
+                                    rtos_mutex_t *mutex)
+svccall(SYSCALL_TASK_RESCHEDULE,    task_reschedule,        void,   void)
+
+// The fast path runs in thread mode so it only touches the current task's own
+// TCB, which the kernel doesn't modify while the task is running, and the
+// mutex's owner, which is updated with exclusive accesses. Anything that would
+// need the kernel's lists is left to the system calls. Calls from handler mode
+// always go to the system calls too, so their usage assertions catch them.
+
+// Lowers a running task to its default priority if it no longer holds any
+// mutexes, then enters the kernel only if that lets another task preempt it or
+// it now needs to be throttled. Reading the ready tasks here is racy, but an
+// interrupt that readies a task after the check sees the lowered priority and
+// preempts the task itself.
+static void mutex_fast_restore_priority(rtos_tcb_t *task) {
+    if (task->mutex_count == 0) {
+        task->base_priority = task->def_priority;
+        task->priority = task->def_priority;
+    }
+    cm4_compiler_barrier();
+    const bool may_be_preempted =
+        tpq_has_above(&state.ready_tasks, task->priority) ||
+        (tcb_is_edf(task) && !tpq_list_is_empty(&state.ready_tasks, task));
+    const bool may_be_throttled =
+        task->budget != 0 && task->budget_left == 0 && task->mutex_count == 0;
+    if (may_be_preempted || may_be_throttled) {
+        task_reschedule();
+    }
+}
+
+// Returns false if the mutex is held or the task can't lock it, in which case
+// the system call handles it. The task is raised to the ceiling before it
+// claims the mutex so that it never holds the mutex at a lower priority.
+// Inheritance mutexes, and tasks holding one, always use the system call since
+// their priority depends on other tasks' priorities.
+static bool mutex_fast_lock(rtos_mutex_t *mutex) {
+    if (cm4_get_ipsr() != 0) {
+        return false;
+    }
+    rtos_tcb_t *const task = state.curr_task;
+    if (mutex == NULL || task == NULL || mutex->owner == task ||
+        mutex->inherit || task->inherit_held != NULL)
+    {
+        return false;
+    }
+    const bool can_lock = task->mutex_count == 0
+                            ? task->def_priority <= mutex->priority_ceil
+                            : task->base_priority == mutex->priority_ceil;
+    if (!can_lock) {
+        return false;
+    }
+
+    task->base_priority = mutex->priority_ceil;
+    task->priority = mutex->priority_ceil;
+    ++task->mutex_count;
+
+    volatile uint32_t *const owner = (volatile uint32_t *)&mutex->owner;
+    do {
+        if (cm4_load_exclusive(owner) != (uint32_t)NULL) {
+            cm4_clear_exclusive();
+            --task->mutex_count;
+            mutex_fast_restore_priority(task);
+            return false;
+        }
+    } while (!cm4_store_exclusive(owner, (uint32_t)task));
+    return true;
+}
+
+// Returns false if any tasks are waiting for the mutex so that the system call
+// can pass it on. A task can only start waiting after a context switch, which
+// fails the exclusive store.
+static bool mutex_fast_unlock(rtos_mutex_t *mutex) {
+    if (cm4_get_ipsr() != 0) {
+        return false;
+    }
+    rtos_tcb_t *const task = state.curr_task;
+    if (mutex == NULL || task == NULL || mutex->inherit ||
+        task->inherit_held != NULL)
+    {
+        return false;
+    }
+
+    volatile uint32_t *const owner = (volatile uint32_t *)&mutex->owner;
+    do {
+        if (cm4_load_exclusive(owner) != (uint32_t)task ||
+            !tlist_is_empty(&mutex->blocked))
+        {
+            cm4_clear_exclusive();
+            return false;
+        }
+    } while (!cm4_store_exclusive(owner, (uint32_t)NULL));
+
+    --task->mutex_count;
+    mutex_fast_restore_priority(task);
+    return true;
+}
+
+void rtos_mutex_lock(rtos_mutex_t *mutex) {
+    if (!mutex_fast_lock(mutex)) {
+        mutex_lock_syscall(mutex);
+    }
+}
+
+void rtos_mutex_unlock(rtos_mutex_t *mutex) {
+    if (!mutex_fast_unlock(mutex)) {
+        mutex_unlock_syscall(mutex);
+    }
+}
+
+#endif // #if RTOS_ENABLE_MUTEX_FAST_PATH
+
+bool rtos_mutex_lock_timed(rtos_mutex_t *mutex, size_t timeout) {
+#if RTOS_ENABLE_MUTEX_FAST_PATH
+    if (mutex_fast_lock(mutex)) {
+        return true;
+    }
+#endif
+    return mutex_lock_timed(mutex, timeout);
+}
+
+// Returns the sequence count to pass to info_read_retry().
+static inline uint32_t info_read_begin(void) {
+    uint32_t seq;
+    do {
+        seq = state.info_seq;
+    } while (seq & 1U);
+    cm4_compiler_barrier();
+    return seq;
+}
+
+static inline bool info_read_retry(uint32_t seq) {
+    cm4_compiler_barrier();
+    return state.info_seq != seq;
+}
+
+// A single word can't be torn so this doesn't need the sequence count.
+rtos_tcb_t *rtos_task_self(void) {
+    USAGE_ASSERT(state.is_started, "RTOS must be started before calling");
+    return *(rtos_tcb_t *volatile *)&state.info.curr_task;
+}
+
+uint64_t rtos_time_now(void) {
+    uint64_t tick_count;
+    uint32_t seq;
+    do {
+        seq = info_read_begin();
+        tick_count = state.info.tick_count;
+    } while (info_read_retry(seq));
+    return tick_count;
+}
+
+// Returns what's left of a timeout that started at start_time, for waits that
+// are repeated after a wakeup that didn't satisfy them.
+static size_t timeout_remaining(size_t timeout, uint64_t start_time) {
+    if (timeout == RTOS_WAIT_FOREVER) {
+        return RTOS_WAIT_FOREVER;
+    }
+    const uint64_t elapsed = rtos_time_now() - start_time;
+    return elapsed >= timeout ? 0 : timeout - elapsed;
+}
+
+void rtos_kernel_info_get(rtos_kernel_info_t *info) {
+    USAGE_ASSERT(info != NULL, "Passed NULL info");
+    uint32_t seq;
+    do {
+        seq = info_read_begin();
+        *info = state.info;
+    } while (info_read_retry(seq));
+}
+
+void rtos_task_get_counters(const rtos_tcb_t *task,
+                            rtos_task_counters_t *counters)
+{
+    USAGE_ASSERT(task != NULL, "Passed NULL task handle");
+    USAGE_ASSERT(counters != NULL, "Passed NULL counters");
+    uint32_t seq;
+    do {
+        seq = info_read_begin();
+        *counters = task->counters;
+    } while (info_read_retry(seq));
+}
+
+// Critical sections are only tracked by a global count since a task can't be
+// switched out while BASEPRI is raised and the interrupts that could nest are
+// masked.
+// The outermost exit restores the BASEPRI found by the outermost enter, in case
+// the caller had already masked some interrupts itself.
+void rtos_critical_enter(void) {
+    USAGE_ASSERT(cm4_get_ipsr() != 0 ||
+                 (cm4_get_control() & cm4_control_npriv_mask) == 0,
+                 "Critical section entered from unprivileged code");
+    const uint32_t basepri = kernel_lock();
+    if (state.critical_nesting == 0) {
+        state.critical_basepri = basepri;
+    }
+    ++state.critical_nesting;
+}
+
+void rtos_critical_exit(void) {
+    USAGE_ASSERT(cm4_get_ipsr() != 0 ||
+                 (cm4_get_control() & cm4_control_npriv_mask) == 0,
+                 "Critical section exited from unprivileged code");
+    USAGE_ASSERT(state.critical_nesting > 0,
+                 "Not in a critical section");
+    if (--state.critical_nesting == 0) {
+        kernel_unlock(state.critical_basepri);
+    }
+}
 
 bool rtos_mqueue_try_enqueue_isr(rtos_mqueue_t *mqueue, const void *data) {
-    cm4_disable_irq();
-    bool success = mqueue_try_enqueue(mqueue, data);
-    cm4_enable_irq();
+    const uint32_t basepri = kernel_lock();
+    bool success = mqueue_produce(mqueue, data, 1) == 1;
+    kernel_unlock(basepri);
+    return success;
+}
+
+// The reserved head and acquired tail can't move until they're committed and
+// released, so the slot can be found after the system call returns.
+void *rtos_mqueue_reserve(rtos_mqueue_t *mqueue) {
+    mqueue_reserve(mqueue);
+    return queue_slot(mqueue, mqueue->head);
+}
+
+void *rtos_mqueue_acquire(rtos_mqueue_t *mqueue) {
+    mqueue_acquire(mqueue);
+    return queue_slot(mqueue, mqueue->tail);
+}
+
+#if RTOS_ENABLE_DEFERRED_WORK
+
+void rtos_work_init(rtos_work_t *work, rtos_work_func_t function, void *arg,
+                    size_t priority)
+{
+    USAGE_ASSERT(priority < RTOS_NUM_WORK_PRIORITY_LEVELS,
+                 "Invalid work priority");
+    work->function = function;
+    work->arg = arg;
+    work->priority = priority;
+    work->is_pending = false;
+    work->next = NULL;
+}
+
+// Returns false if the work is already pending, in which case it will still
+// only run once.
+bool rtos_work_post_isr(rtos_work_t *work) {
+    bool success = false;
+    const uint32_t basepri = kernel_lock();
+    if (!work->is_pending) {
+        work->is_pending = true;
+        workq_push_back(&state.pending_work, work);
+        if (state.worker_task.state == RTOS_TASKSTATE_WAIT_WORK) {
+            make_task_ready(&state.worker_task);
+        }
+        success = true;
+    }
+    kernel_unlock(basepri);
     return success;
 }
+
+#endif // #if RTOS_ENABLE_DEFERRED_WORK
+
+void rtos_ring_create(rtos_ring_t *ring, uint8_t *buffer, size_t slots,
+                      size_t slot_size)
+{
+    USAGE_ASSERT(ring != NULL, "Passed NULL ring");
+    USAGE_ASSERT(slots != 0 && (slots & (slots - 1)) == 0,
+                 "Number of slots must be a power of two");
+    *ring = (rtos_ring_t){
+        .data = buffer,
+        .slots = slots,
+        .slot_size = slot_size,
+        .head = 0,
+        .tail = 0,
+        .consumer = NULL,
+    };
+}
+
+void rtos_ring_destroy(rtos_ring_t *ring) {
+    USAGE_ASSERT(ring != NULL, "Passed NULL ring");
+    USAGE_ASSERT(ring->consumer == NULL,
+                 "Destroying ring that a task is waiting on");
+}
+
+// The slot is filled before the head is advanced so the consumer never sees a
+// partly written slot. The consumer only waits after the kernel has checked
+// that the ring is empty, so it's only waiting here if this write made the ring
+// non-empty. Checking after the head is advanced means it can't be missed.
+bool rtos_ring_try_write(rtos_ring_t *ring, const void *data) {
+    const size_t head = ring->head;
+    const size_t tail = ring->tail;
+    if (head - tail == ring->slots) {
+        return false;
+    }
+    ring_copy(ring_slot(ring, head), data, ring->slot_size);
+    cm4_compiler_barrier();
+    ring->head = head + 1;
+    if (ring->consumer != NULL) {
+        ring_wake(ring);
+    }
+    return true;
+}
+
+bool rtos_ring_try_read(rtos_ring_t *ring, void *data) {
+    const size_t tail = ring->tail;
+    if (ring->head == tail) {
+        return false;
+    }
+    cm4_compiler_barrier();
+    ring_copy(data, ring_slot(ring, tail), ring->slot_size);
+    cm4_compiler_barrier();
+    ring->tail = tail + 1;
+    return true;
+}
+
+void rtos_ring_read(rtos_ring_t *ring, void *data) {
+    while (!rtos_ring_try_read(ring, data)) {
+        ring_wait(ring);
+    }
+}
+
+static void stream_init(rtos_stream_t *stream, uint8_t *buffer, size_t size,
+                        size_t trigger, bool is_message)
+{
+    *stream = (rtos_stream_t){
+        .data = buffer,
+        .size = size,
+        .head = 0,
+        .tail = 0,
+        .used = 0,
+        .trigger = trigger,
+        .is_message = is_message,
+        .senders = {0},
+        .receivers = {0},
+    };
+}
+
+static void stream_check_destroy(const rtos_stream_t *stream) {
+    USAGE_ASSERT(tlist_is_empty(&stream->senders) &&
+                 tlist_is_empty(&stream->receivers),
+                 "Destroying stream that tasks are still waiting on");
+}
+
+void rtos_stream_create(rtos_stream_t *stream, uint8_t *buffer, size_t size,
+                        size_t trigger)
+{
+    USAGE_ASSERT(stream != NULL, "Passed NULL stream");
+    USAGE_ASSERT(trigger <= size, "Trigger level is more than the size");
+    stream_init(stream, buffer, size, trigger, false);
+}
+
+void rtos_stream_destroy(rtos_stream_t *stream) {
+    USAGE_ASSERT(stream != NULL, "Passed NULL stream");
+    stream_check_destroy(stream);
+}
+
+size_t rtos_stream_send_isr(rtos_stream_t *stream, const void *data,
+                            size_t len)
+{
+    const uint32_t basepri = kernel_lock();
+    const size_t sent = stream_send_now(stream, data, len);
+    kernel_unlock(basepri);
+    return sent;
+}
+
+size_t rtos_stream_receive_isr(rtos_stream_t *stream, void *data,
+                               size_t max_len)
+{
+    const uint32_t basepri = kernel_lock();
+    size_t received;
+    stream_take(stream, data, max_len, 0, &received);
+    stream_wake_waiters(stream);
+    kernel_unlock(basepri);
+    return received;
+}
+
+void rtos_msgbuf_create(rtos_msgbuf_t *msgbuf, uint8_t *buffer, size_t size) {
+    USAGE_ASSERT(msgbuf != NULL, "Passed NULL message buffer");
+    USAGE_ASSERT(size > STREAM_HEADER_SIZE, "Message buffer is too small");
+    stream_init(&msgbuf->stream, buffer, size, 0, true);
+}
+
+void rtos_msgbuf_destroy(rtos_msgbuf_t *msgbuf) {
+    USAGE_ASSERT(msgbuf != NULL, "Passed NULL message buffer");
+    stream_check_destroy(&msgbuf->stream);
+}
+
+void rtos_msgbuf_send(rtos_msgbuf_t *msgbuf, const void *data, size_t len) {
+    rtos_stream_send(&msgbuf->stream, data, len);
+}
+
+size_t rtos_msgbuf_receive(rtos_msgbuf_t *msgbuf, void *data, size_t max_len) {
+    return rtos_stream_receive(&msgbuf->stream, data, max_len);
+}
+
+bool rtos_msgbuf_send_isr(rtos_msgbuf_t *msgbuf, const void *data,
+                          size_t len)
+{
+    USAGE_ASSERT(len != 0, "Message is empty");
+    return rtos_stream_send_isr(&msgbuf->stream, data, len) == len;
+}
+
+size_t rtos_msgbuf_receive_isr(rtos_msgbuf_t *msgbuf, void *data,
+                               size_t max_len)
+{
+    return rtos_stream_receive_isr(&msgbuf->stream, data, max_len);
+}
+
+void rtos_event_group_create(rtos_event_group_t *group) {
+    USAGE_ASSERT(group != NULL, "Passed NULL event group");
+    *group = (rtos_event_group_t){
+        .flags = 0,
+        .waiting = {0},
+        .select = NULL,
+    };
+}
+
+void rtos_event_group_destroy(rtos_event_group_t *group) {
+    USAGE_ASSERT(group != NULL, "Passed NULL event group");
+    USAGE_ASSERT(tlist_is_empty(&group->waiting),
+                 "Destroying event group that tasks are still waiting on");
+    USAGE_ASSERT(group->select == NULL,
+                 "Destroying event group that is still a member of a select");
+}
+
+uint32_t rtos_event_group_get(const rtos_event_group_t *group) {
+    return group->flags;
+}
+
+uint32_t rtos_event_group_wait(rtos_event_group_t *group, uint32_t flags,
+                               uint32_t options)
+{
+    return rtos_event_group_wait_timed(group, flags, options,
+                                       RTOS_WAIT_FOREVER);
+}
+
+void rtos_rwlock_create(rtos_rwlock_t *rwlock, size_t priority_ceil) {
+    USAGE_ASSERT(rwlock != NULL, "Passed NULL rwlock");
+    USAGE_ASSERT(priority_ceil <= RTOS_MAX_TASK_PRIORITY,
+                 "Ceiling must be at most RTOS_MAX_TASK_PRIORITY");
+    *rwlock = (rtos_rwlock_t){
+        .writer = NULL,
+        .readers = 0,
+        .waiting_readers = {0},
+        .waiting_writers = {0},
+        .priority_ceil = priority_ceil,
+    };
+}
+
+void rtos_rwlock_destroy(rtos_rwlock_t *rwlock) {
+    USAGE_ASSERT(rwlock != NULL, "Passed NULL rwlock");
+    USAGE_ASSERT(rwlock->writer == NULL && rwlock->readers == 0,
+                 "Destroying rwlock that is still locked");
+    ASSERT(tlist_is_empty(&rwlock->waiting_readers) &&
+           tlist_is_empty(&rwlock->waiting_writers));
+}
+
+void rtos_sem_create(rtos_sem_t *sem, size_t initial_count, size_t max_count) {
+    USAGE_ASSERT(sem != NULL, "Passed NULL semaphore");
+    USAGE_ASSERT(max_count != 0 && initial_count <= max_count,
+                 "Initial count must not be more than a non-zero maximum");
+    sem->count = initial_count;
+    sem->max_count = max_count;
+    sem->waiting.head = NULL;
+    sem->waiting.tail = NULL;
+    sem->select = NULL;
+}
+
+void rtos_sem_destroy(rtos_sem_t *sem) {
+    USAGE_ASSERT(sem != NULL, "Passed NULL semaphore");
+    USAGE_ASSERT(tlist_is_empty(&sem->waiting),
+                 "Destroying semaphore that tasks are still waiting on");
+    USAGE_ASSERT(sem->select == NULL,
+                 "Destroying semaphore that is still a member of a select");
+}
+
+void rtos_sem_take(rtos_sem_t *sem) {
+    sem_take(sem, RTOS_WAIT_FOREVER);
+}
+
+bool rtos_sem_take_timed(rtos_sem_t *sem, size_t timeout) {
+    return sem_take(sem, timeout);
+}
+
+bool rtos_task_notify_isr(rtos_tcb_t *task, uint32_t value,
+                          rtos_notify_action_t action)
+{
+    const uint32_t basepri = kernel_lock();
+    const bool notified = prv_task_notify(task, value, action);
+    kernel_unlock(basepri);
+    return notified;
+}
+
+// Only the task itself takes its notification, so a non-zero value can be
+// taken without a system call. The kernel only changes the value from
+// exception handlers, and exception entry fails the exclusive store.
+static bool task_notify_take(rtos_tcb_t *task, bool clear, uint32_t *taken) {
+    volatile uint32_t *const value = &task->notify_value;
+    uint32_t old;
+    do {
+        old = cm4_load_exclusive(value);
+        if (old == 0) {
+            cm4_clear_exclusive();
+            return false;
+        }
+    } while (!cm4_store_exclusive(value, clear ? 0 : old - 1));
+    *taken = old;
+    return true;
+}
+
+uint32_t rtos_task_notify_wait(bool clear) {
+    return rtos_task_notify_wait_timed(clear, RTOS_WAIT_FOREVER);
+}
+
+// Loops because an overwrite with 0 can empty the value again between the
+// wakeup and the take. Each wait only gets what's left of the timeout.
+uint32_t rtos_task_notify_wait_timed(bool clear, size_t timeout) {
+    rtos_tcb_t *const task = rtos_task_self();
+    const uint64_t start_time = rtos_time_now();
+    uint32_t taken;
+    while (!task_notify_take(task, clear, &taken)) {
+        if (!task_notify_wait(timeout_remaining(timeout, start_time))) {
+            return 0;
+        }
+    }
+    return taken;
+}
+
+bool rtos_sem_give_isr(rtos_sem_t *sem) {
+    const uint32_t basepri = kernel_lock();
+    const bool given = prv_sem_give(sem);
+    kernel_unlock(basepri);
+    return given;
+}
+
+void rtos_event_group_set_isr(rtos_event_group_t *group, uint32_t flags) {
+    const uint32_t basepri = kernel_lock();
+    prv_event_group_set(group, flags);
+    kernel_unlock(basepri);
+}
+
+void rtos_event_group_clear_isr(rtos_event_group_t *group, uint32_t flags) {
+    const uint32_t basepri = kernel_lock();
+    prv_event_group_clear(group, flags);
+    kernel_unlock(basepri);
+}
+
+static struct rtos_select **select_hook(const rtos_select_member_t *member) {
+    if (member->kind == RTOS_SELECT_MQUEUE) {
+        return &((rtos_mqueue_t *)member->object)->select;
+    } else if (member->kind == RTOS_SELECT_SEM) {
+        return &((rtos_sem_t *)member->object)->select;
+    }
+    USAGE_ASSERT(member->kind == RTOS_SELECT_EVENT_GROUP,
+                 "Invalid select member kind");
+    return &((rtos_event_group_t *)member->object)->select;
+}
+
+// The members must already be created and stay alive until the select is
+// destroyed. The member array isn't copied.
+void rtos_select_create(rtos_select_t *select,
+                        const rtos_select_member_t *members, size_t count)
+{
+    USAGE_ASSERT(select != NULL, "Passed NULL select");
+    USAGE_ASSERT(members != NULL && count > 0, "Select must have members");
+    *select = (rtos_select_t){
+        .members = members,
+        .count = count,
+        .waiting = {0},
+    };
+    for (size_t i = 0; i < count; ++i) {
+        USAGE_ASSERT(members[i].object != NULL, "Passed NULL select member");
+        USAGE_ASSERT(members[i].kind != RTOS_SELECT_EVENT_GROUP ||
+                     members[i].flags != 0,
+                     "Event group members must wait for at least one flag");
+        struct rtos_select **const hook = select_hook(&members[i]);
+        USAGE_ASSERT(*hook == NULL, "Object is already a member of a select");
+        *hook = select;
+    }
+}
+
+void rtos_select_destroy(rtos_select_t *select) {
+    USAGE_ASSERT(select != NULL, "Passed NULL select");
+    USAGE_ASSERT(tlist_is_empty(&select->waiting),
+                 "Destroying select that tasks are still waiting on");
+    for (size_t i = 0; i < select->count; ++i) {
+        *select_hook(&select->members[i]) = NULL;
+    }
+}
+
+size_t rtos_select_wait(rtos_select_t *select) {
+    return rtos_select_wait_timed(select, RTOS_WAIT_FOREVER);
+}
+
+// Waits again with what's left of the timeout if the member that woke the task
+// was no longer ready when the members were checked again.
+size_t rtos_select_wait_timed(rtos_select_t *select, size_t timeout) {
+    const uint64_t start_time = rtos_time_now();
+    size_t index;
+    do {
+        index = select_wait(select, timeout_remaining(timeout, start_time));
+    } while (index == SELECT_WOKEN);
+    return index;
+}
@@ -22,10 +22,83 @@ extern "C" {
 #define RTOS_NUM_PRIORITY_LEVELS 3
 #endif
 
+// When enabled, SysTick interrupts are suppressed while the idle task runs
+// until the next sleeping task is due to wake.
+#ifndef RTOS_ENABLE_TICKLESS_IDLE
+#define RTOS_ENABLE_TICKLESS_IDLE 0
+#endif
+
+// When enabled, tasks at RTOS_EDF_PRIORITY are scheduled earliest deadline
+// first instead of being time-sliced. Tasks at other priorities are scheduled
+// as usual.
+#ifndef RTOS_ENABLE_EDF
+#define RTOS_ENABLE_EDF 0
+#endif
+
+#ifndef RTOS_EDF_PRIORITY
+#define RTOS_EDF_PRIORITY 1
+#endif
+
+// When enabled, creating a deadline task fails if the total utilization of
+// the deadline tasks would exceed 100%.
+#ifndef RTOS_ENABLE_EDF_ADMISSION
+#define RTOS_ENABLE_EDF_ADMISSION 0
+#endif
+
+// Number of levels in the sleeping task timing wheel. Each level has 32 slots
+// so the default covers delays of up to 2^20 ticks without reinsertion.
+#ifndef RTOS_TIMER_WHEEL_LEVELS
+#define RTOS_TIMER_WHEEL_LEVELS 4
+#endif
+
+// When enabled, interrupts can defer work to a kernel worker task which runs
+// at RTOS_MAX_TASK_PRIORITY. Work items have their own priorities which order
+// them within the worker.
+#ifndef RTOS_ENABLE_DEFERRED_WORK
+#define RTOS_ENABLE_DEFERRED_WORK 0
+#endif
+
+#ifndef RTOS_NUM_WORK_PRIORITY_LEVELS
+#define RTOS_NUM_WORK_PRIORITY_LEVELS 4
+#endif
+
+#ifndef RTOS_WORKER_STACK_SIZE
+#define RTOS_WORKER_STACK_SIZE 512
+#endif
+
+// When enabled, uncontended mutex locks and unlocks are done in thread mode
+// without a system call.
+#ifndef RTOS_ENABLE_MUTEX_FAST_PATH
+#define RTOS_ENABLE_MUTEX_FAST_PATH 1
+#endif
+
+// When disabled, system calls use the original ABI: the number is encoded in
+// the SVC instruction and dispatched with a switch, and calls can't be made
+// from handler mode. This is only useful for comparing the cost of the two.
+#ifndef RTOS_ENABLE_SYSCALL_TABLE
+#define RTOS_ENABLE_SYSCALL_TABLE 1
+#endif
+
+// The kernel masks interrupts with BASEPRI instead of disabling them. Only
+// interrupts with a priority value of at least RTOS_MAX_SYSCALL_IRQ_PRIORITY
+// are masked, so these are the only interrupts that may call RTOS functions.
+// Interrupts with a lower value are never delayed by the kernel. The value is
+// the NVIC priority before being shifted into the implemented priority bits.
+#ifndef RTOS_MAX_SYSCALL_IRQ_PRIORITY
+#define RTOS_MAX_SYSCALL_IRQ_PRIORITY 5
+#endif
+
+#ifndef RTOS_NVIC_PRIORITY_BITS
+#define RTOS_NVIC_PRIORITY_BITS 4
+#endif
+
 enum {
     RTOS_MAX_TASK_PRIORITY = RTOS_NUM_PRIORITY_LEVELS - 1,
 };
 
+// Timeout for the _timed functions that never expires
+#define RTOS_WAIT_FOREVER SIZE_MAX
+
 typedef enum {
     RTOS_TASKSTATE_RUNNING,
     RTOS_TASKSTATE_READY,
@@ -36,8 +109,26 @@ typedef enum {
     RTOS_TASKSTATE_WAIT_COND,
     RTOS_TASKSTATE_WAIT_DEQUEUE,
     RTOS_TASKSTATE_WAIT_ENQUEUE,
+    RTOS_TASKSTATE_THROTTLED,
+    RTOS_TASKSTATE_WAIT_WORK,
+    RTOS_TASKSTATE_WAIT_RING,
+    RTOS_TASKSTATE_WAIT_RESERVE,
+    RTOS_TASKSTATE_WAIT_ACQUIRE,
+    RTOS_TASKSTATE_WAIT_STREAM_SEND,
+    RTOS_TASKSTATE_WAIT_STREAM_RECEIVE,
+    RTOS_TASKSTATE_WAIT_EVENT,
+    RTOS_TASKSTATE_WAIT_SEM,
+    RTOS_TASKSTATE_WAIT_NOTIFY,
+    RTOS_TASKSTATE_WAIT_SELECT,
+    RTOS_TASKSTATE_WAIT_READ,
+    RTOS_TASKSTATE_WAIT_WRITE,
 } rtos_taskstate_t;
 
+typedef enum {
+    RTOS_SCHED_RR,      // Time-sliced with other tasks at the same priority
+    RTOS_SCHED_FIFO,    // Runs until it blocks or yields
+} rtos_sched_policy_t;
+
 typedef void (*rtos_task_func_t)(void *);
 
 struct rtos_tcb;
@@ -47,26 +138,77 @@ typedef struct {
     struct rtos_tcb *tail;
 } rtos_tlist_t;
 
+struct rtos_timer_list;
+
+typedef struct rtos_timer {
+    size_t                      wake_time;
+    struct rtos_timer_list *    list;   // NULL while not in the wheel
+    struct rtos_timer *         prev;
+    struct rtos_timer *         next;
+} rtos_timer_t;
+
 typedef struct {
-    rtos_tlist_t tlists[RTOS_NUM_PRIORITY_LEVELS];
-} rtos_tpq_t;
+    size_t max_release_jitter;  // Ticks from a release until the task ran
+    size_t max_response_time;   // Ticks from a release until the job finished
+    size_t overruns;            // Releases that were already due when the
+                                // previous job finished
+    size_t throttles;           // Times the task exhausted its budget
+    size_t budget_left;         // Ticks of budget left in the current period
+} rtos_task_stats_t;
+
+// Counters the kernel keeps for every task, which can be read without a
+// system call.
+typedef struct {
+    size_t activations;         // Times the task was switched in
+    size_t run_ticks;           // Ticks that occurred while the task ran
+} rtos_task_counters_t;
 
 typedef struct rtos_tcb {
     stack_frame_switch_t *  switch_frame;
     size_t *                stack_low;
     size_t                  priority;
     size_t                  def_priority;
+    size_t                  base_priority;  // Default or ceiling priority
+    size_t                  deadline;       // Relative, non-zero for EDF
+    size_t                  abs_deadline;
+    size_t                  wcet;
+    rtos_sched_policy_t     policy;
+    size_t                  time_slice;
     size_t                  slice_left;
-    size_t                  wake_time;
+    size_t                  budget;         // Non-zero when reserved
+    size_t                  budget_period;
+    size_t                  budget_left;
+    size_t                  replenish_time;
+    rtos_timer_t            timer;
     rtos_taskstate_t        state;
     rtos_tlist_t            waiting_to_join;
-    size_t                  mutex_count;
-    uint8_t *               mqueue_data;
+    size_t                  mutex_count;    // Ceiling locks held
+    struct rtos_mutex *     inherit_held;   // Inheritance mutexes held
+    size_t                  period;         // Non-zero when periodic
+    size_t                  release_time;
+    bool                    job_started;
+    rtos_task_stats_t       stats;
+    rtos_task_counters_t    counters;
+    uint8_t *               wait_data;      // Caller's buffer while blocked
+    size_t                  wait_count;     // Messages or bytes still wanted
+    size_t                  wait_min;       // Needed before waking
+    size_t *                syscall_result; // Stacked R0 of its last syscall
+    void *                  wait_object;    // What a timed wait is blocked on
+    uint32_t                wait_flags;     // Event flags waited for
+    uint32_t                wait_options;
+    volatile uint32_t       notify_value;
     bool                    privileged;
     struct rtos_tcb *       prev;
     struct rtos_tcb *       next;
 } rtos_tcb_t;
 
+typedef enum {
+    RTOS_NOTIFY_SET_BITS,           // OR the value into the notification
+    RTOS_NOTIFY_INCREMENT,          // Ignore the value and add one
+    RTOS_NOTIFY_OVERWRITE,
+    RTOS_NOTIFY_OVERWRITE_IF_EMPTY, // Fails if the notification isn't 0
+} rtos_notify_action_t;
+
 typedef struct {
     rtos_task_func_t    function;
     void *              task_arg;
@@ -74,12 +216,20 @@ typedef struct {
     size_t              stack_size;
     size_t              priority;
     bool                privileged;
+    size_t              deadline;
+    size_t              wcet;
+    rtos_sched_policy_t policy;
+    size_t              time_slice;
+    size_t              budget;
+    size_t              budget_period;
 } rtos_task_settings_t;
 
-typedef struct {
+typedef struct rtos_mutex {
     rtos_tcb_t *owner;
-    rtos_tpq_t blocked;
+    rtos_tlist_t blocked;           // Sorted by priority
     size_t priority_ceil;
+    bool inherit;                   // Uses priority inheritance, not a ceiling
+    struct rtos_mutex *next_held;   // Next in the owner's inherit_held list
 } rtos_mutex_t;
 
 typedef struct {
@@ -87,46 +237,107 @@ typedef struct {
     rtos_tlist_t waiting;
 } rtos_cond_t;
 
+// Kernel state that's published for tasks to read without a system call.
+typedef struct {
+    struct rtos_tcb *   curr_task;
+    uint64_t            tick_count;
+    uint32_t            epoch;      // Number of context switches
+} rtos_kernel_info_t;
+
 void rtos_tick(void);
 
+void rtos_critical_enter(void);
+void rtos_critical_exit(void);
+
 [[noreturn]] void rtos_start(void);
 
-void rtos_task_create(rtos_tcb_t *task, const rtos_task_settings_t *settings);
+bool rtos_task_create(rtos_tcb_t *task, const rtos_task_settings_t *settings);
 
 rtos_tcb_t *rtos_task_self(void);
 
+uint64_t rtos_time_now(void);
+
+void rtos_kernel_info_get(rtos_kernel_info_t *info);
+
 [[noreturn]] void rtos_task_exit(void);
 
 void rtos_task_yield(void);
 
 void rtos_task_sleep(size_t ticks);
 
+void rtos_task_sleep_until(size_t *last_wake, size_t period);
+
 void rtos_task_suspend(void);
 
 void rtos_task_resume(rtos_tcb_t *task);
 
 void rtos_task_join(rtos_tcb_t *task);
 
+bool rtos_task_join_timed(rtos_tcb_t *task, size_t timeout);
+
+void rtos_task_get_stats(const rtos_tcb_t *task, rtos_task_stats_t *stats);
+
+bool rtos_task_notify(rtos_tcb_t *task, uint32_t value,
+                      rtos_notify_action_t action);
+
+bool rtos_task_notify_isr(rtos_tcb_t *task, uint32_t value,
+                          rtos_notify_action_t action);
+
+uint32_t rtos_task_notify_wait(bool clear);
+
+uint32_t rtos_task_notify_wait_timed(bool clear, size_t timeout);
+
+void rtos_task_get_counters(const rtos_tcb_t *task,
+                            rtos_task_counters_t *counters);
+
 void rtos_mutex_create(rtos_mutex_t *mutex, size_t priority_ceil);
+void rtos_mutex_create_inherit(rtos_mutex_t *mutex);
 void rtos_mutex_destroy(rtos_mutex_t *mutex);
 void rtos_mutex_lock(rtos_mutex_t *mutex);
+bool rtos_mutex_lock_timed(rtos_mutex_t *mutex, size_t timeout);
 bool rtos_mutex_trylock(rtos_mutex_t *mutex);
 void rtos_mutex_unlock(rtos_mutex_t *mutex);
 
+// Held by any number of readers or by one writer. New readers wait behind a
+// waiting writer so that writers aren't starved. Holding it for either counts
+// as holding a mutex, so holders run at the ceiling priority the same way.
+typedef struct {
+    rtos_tcb_t *    writer;
+    size_t          readers;
+    rtos_tlist_t    waiting_readers;
+    rtos_tlist_t    waiting_writers;
+    size_t          priority_ceil;
+} rtos_rwlock_t;
+
+void rtos_rwlock_create(rtos_rwlock_t *rwlock, size_t priority_ceil);
+void rtos_rwlock_destroy(rtos_rwlock_t *rwlock);
+void rtos_rwlock_read_lock(rtos_rwlock_t *rwlock);
+void rtos_rwlock_read_unlock(rtos_rwlock_t *rwlock);
+void rtos_rwlock_write_lock(rtos_rwlock_t *rwlock);
+void rtos_rwlock_write_unlock(rtos_rwlock_t *rwlock);
+
 void rtos_cond_create(rtos_cond_t *cond);
 void rtos_cond_destroy(rtos_cond_t *cond);
 void rtos_cond_wait(rtos_cond_t *cond, rtos_mutex_t *mutex);
+bool rtos_cond_wait_timed(rtos_cond_t *cond, rtos_mutex_t *mutex,
+                          size_t timeout);
 void rtos_cond_signal(rtos_cond_t *cond);
 void rtos_cond_broadcast(rtos_cond_t *cond);
 
+struct rtos_select;
+
 typedef struct {
     size_t          slots;
     size_t          slot_size;
     size_t          head;
     size_t          tail;
     bool            is_full;
-    rtos_tlist_t    waiting;
+    rtos_tlist_t    producers;      // Waiting to enqueue or reserve
+    rtos_tlist_t    consumers;      // Waiting to dequeue or acquire
+    rtos_tcb_t *    reserved_by;    // Owns the slot at the head
+    rtos_tcb_t *    acquired_by;    // Owns the slot at the tail
     uint8_t *       data;
+    struct rtos_select *select;     // Set while it's a member of a select
 } rtos_mqueue_t;
 
 void rtos_mqueue_create(rtos_mqueue_t *mqueue, uint8_t *buffer, size_t slots,
@@ -134,7 +345,165 @@ void rtos_mqueue_create(rtos_mqueue_t *mqueue, uint8_t *buffer, size_t slots,
 void rtos_mqueue_destroy(rtos_mqueue_t *mqueue);
 void rtos_mqueue_enqueue(rtos_mqueue_t *mqueue, const void *data);
 void rtos_mqueue_dequeue(rtos_mqueue_t *mqueue, void *data);
+bool rtos_mqueue_enqueue_timed(rtos_mqueue_t *mqueue, const void *data,
+                               size_t timeout);
+bool rtos_mqueue_dequeue_timed(rtos_mqueue_t *mqueue, void *data,
+                               size_t timeout);
+size_t rtos_mqueue_enqueue_n(rtos_mqueue_t *mqueue, const void *data,
+                             size_t count, size_t min_count);
+size_t rtos_mqueue_dequeue_n(rtos_mqueue_t *mqueue, void *data, size_t count,
+                             size_t min_count);
+size_t rtos_mqueue_enqueue_n_timed(rtos_mqueue_t *mqueue, const void *data,
+                                   size_t count, size_t min_count,
+                                   size_t timeout);
+size_t rtos_mqueue_dequeue_n_timed(rtos_mqueue_t *mqueue, void *data,
+                                   size_t count, size_t min_count,
+                                   size_t timeout);
 bool rtos_mqueue_try_enqueue_isr(rtos_mqueue_t *mqueue, const void *data);
+void *rtos_mqueue_reserve(rtos_mqueue_t *mqueue);
+void rtos_mqueue_commit(rtos_mqueue_t *mqueue);
+void *rtos_mqueue_acquire(rtos_mqueue_t *mqueue);
+void rtos_mqueue_release(rtos_mqueue_t *mqueue);
+
+// Byte stream, or a message buffer of length-prefixed records stored
+// contiguously in one ring.
+typedef struct {
+    uint8_t *       data;
+    size_t          size;
+    size_t          head;
+    size_t          tail;
+    size_t          used;
+    size_t          trigger;    // Bytes a blocked receiver waits for
+    bool            is_message;
+    rtos_tlist_t    senders;
+    rtos_tlist_t    receivers;
+} rtos_stream_t;
+
+void rtos_stream_create(rtos_stream_t *stream, uint8_t *buffer, size_t size,
+                        size_t trigger);
+void rtos_stream_destroy(rtos_stream_t *stream);
+void rtos_stream_send(rtos_stream_t *stream, const void *data, size_t len);
+size_t rtos_stream_receive(rtos_stream_t *stream, void *data, size_t max_len);
+size_t rtos_stream_send_isr(rtos_stream_t *stream, const void *data,
+                            size_t len);
+size_t rtos_stream_receive_isr(rtos_stream_t *stream, void *data,
+                               size_t max_len);
+
+typedef struct {
+    rtos_stream_t stream;
+} rtos_msgbuf_t;
+
+void rtos_msgbuf_create(rtos_msgbuf_t *msgbuf, uint8_t *buffer, size_t size);
+void rtos_msgbuf_destroy(rtos_msgbuf_t *msgbuf);
+void rtos_msgbuf_send(rtos_msgbuf_t *msgbuf, const void *data, size_t len);
+size_t rtos_msgbuf_receive(rtos_msgbuf_t *msgbuf, void *data, size_t max_len);
+bool rtos_msgbuf_send_isr(rtos_msgbuf_t *msgbuf, const void *data,
+                          size_t len);
+size_t rtos_msgbuf_receive_isr(rtos_msgbuf_t *msgbuf, void *data,
+                               size_t max_len);
+size_t rtos_msgbuf_discard(rtos_msgbuf_t *msgbuf);
+
+// Counting semaphore, or a binary semaphore when max_count is 1. Waiters are
+// woken in priority order.
+typedef struct {
+    size_t              count;
+    size_t              max_count;
+    rtos_tlist_t        waiting;        // Sorted by priority
+    struct rtos_select *select;     // Set while it's a member of a select
+} rtos_sem_t;
+
+void rtos_sem_create(rtos_sem_t *sem, size_t initial_count, size_t max_count);
+void rtos_sem_destroy(rtos_sem_t *sem);
+void rtos_sem_take(rtos_sem_t *sem);
+bool rtos_sem_take_timed(rtos_sem_t *sem, size_t timeout);
+bool rtos_sem_give(rtos_sem_t *sem);
+bool rtos_sem_give_isr(rtos_sem_t *sem);
+
+// Options for rtos_event_group_wait()
+enum {
+    RTOS_EVENT_WAIT_ALL         = 1U << 0,  // Otherwise waits for any
+    RTOS_EVENT_CLEAR_ON_EXIT    = 1U << 1,  // Clear the flags waited for
+};
+
+typedef struct {
+    volatile uint32_t   flags;
+    rtos_tlist_t        waiting;
+    struct rtos_select *select;     // Set while it's a member of a select
+} rtos_event_group_t;
+
+void rtos_event_group_create(rtos_event_group_t *group);
+void rtos_event_group_destroy(rtos_event_group_t *group);
+void rtos_event_group_set(rtos_event_group_t *group, uint32_t flags);
+void rtos_event_group_clear(rtos_event_group_t *group, uint32_t flags);
+void rtos_event_group_set_isr(rtos_event_group_t *group, uint32_t flags);
+void rtos_event_group_clear_isr(rtos_event_group_t *group, uint32_t flags);
+uint32_t rtos_event_group_get(const rtos_event_group_t *group);
+uint32_t rtos_event_group_wait(rtos_event_group_t *group, uint32_t flags,
+                               uint32_t options);
+uint32_t rtos_event_group_wait_timed(rtos_event_group_t *group, uint32_t flags,
+                                     uint32_t options, size_t timeout);
+
+typedef enum {
+    RTOS_SELECT_MQUEUE,         // Ready when a message can be dequeued
+    RTOS_SELECT_SEM,            // Ready when the count is non-zero
+    RTOS_SELECT_EVENT_GROUP,    // Ready when any of the member's flags are set
+} rtos_select_kind_t;
+
+typedef struct {
+    rtos_select_kind_t  kind;
+    void *              object;
+    uint32_t            flags;  // Only used by event groups
+} rtos_select_member_t;
+
+// Lets a task wait for whichever of several objects becomes ready first. An
+// object can be a member of at most one select.
+typedef struct rtos_select {
+    const rtos_select_member_t *members;
+    size_t                      count;
+    rtos_tlist_t                waiting;
+} rtos_select_t;
+
+// Returned by rtos_select_wait_timed() if the timeout expires
+#define RTOS_SELECT_TIMED_OUT SIZE_MAX
+
+void rtos_select_create(rtos_select_t *select,
+                        const rtos_select_member_t *members, size_t count);
+void rtos_select_destroy(rtos_select_t *select);
+size_t rtos_select_wait(rtos_select_t *select);
+size_t rtos_select_wait_timed(rtos_select_t *select, size_t timeout);
+
+// Single-producer, single-consumer ring. Neither side locks or enters the
+// kernel except to block the consumer when the ring is empty and to wake it
+// when the ring stops being empty.
+typedef struct {
+    uint8_t *                   data;
+    size_t                      slots;      // Power of two
+    size_t                      slot_size;
+    volatile size_t             head;       // Only written by the producer
+    volatile size_t             tail;       // Only written by the consumer
+    struct rtos_tcb *volatile   consumer;   // Set while the consumer waits
+} rtos_ring_t;
+
+void rtos_ring_create(rtos_ring_t *ring, uint8_t *buffer, size_t slots,
+                      size_t slot_size);
+void rtos_ring_destroy(rtos_ring_t *ring);
+bool rtos_ring_try_write(rtos_ring_t *ring, const void *data);
+bool rtos_ring_try_read(rtos_ring_t *ring, void *data);
+void rtos_ring_read(rtos_ring_t *ring, void *data);
+
+typedef void (*rtos_work_func_t)(void *);
+
+typedef struct rtos_work {
+    rtos_work_func_t    function;
+    void *              arg;
+    size_t              priority;
+    bool                is_pending;
+    struct rtos_work *  next;
+} rtos_work_t;
+
+void rtos_work_init(rtos_work_t *work, rtos_work_func_t function, void *arg,
+                    size_t priority);
+bool rtos_work_post_isr(rtos_work_t *work);
 
 #ifdef __cplusplus
 }
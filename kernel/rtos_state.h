@@ -2,6 +2,8 @@
 
 #include "rtos.h"
 #include "tpq.h"
+#include "wheel.h"
+#include "workq.h"
 
 #include <stdint.h>
 
@@ -12,8 +14,27 @@ typedef struct {
     bool            is_started;
     bool            is_preempting; // TODO: Is there a better alternative?
     size_t          tick_count;
+    size_t          critical_nesting; // Of rtos_critical_enter()
+    uint32_t        critical_basepri; // Restored by the outermost exit
+    // Published kernel info. The sequence count is odd while the info or any
+    // task's counters are being updated.
+    rtos_kernel_info_t info;
+    volatile uint32_t info_seq;
+#if RTOS_ENABLE_EDF_ADMISSION
+    uint32_t        edf_utilization; // Fraction of 2^16
+#endif
+#if RTOS_ENABLE_TICKLESS_IDLE
+    uint32_t        cycles_per_tick;
+    size_t          suppressed_ticks; // Length of the current tickless period
+#endif
     rtos_tpq_t      ready_tasks;
-    rtos_tlist_t    sleeping_tasks;
+    rtos_wheel_t    sleeping_tasks;
     rtos_tcb_t      idle_task;
     uint8_t         idle_task_stack[256] __attribute__((aligned(8)));
+#if RTOS_ENABLE_DEFERRED_WORK
+    rtos_workq_t    pending_work;
+    rtos_tcb_t      worker_task;
+    uint8_t         worker_task_stack[RTOS_WORKER_STACK_SIZE]
+                        __attribute__((aligned(8)));
+#endif
 } rtos_state_t;
@@ -0,0 +1,55 @@
+#pragma once
+
+#include "ring.h"
+#include "rtos.h"
+#include "rtos_assert.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Bytes are stored between the tail and the head, wrapping at the end of the
+// buffer. In a message buffer each record is a length followed by that many
+// bytes and may wrap like any other bytes.
+enum {
+    STREAM_HEADER_SIZE = sizeof(size_t),
+};
+
+static size_t stream_free(const rtos_stream_t *stream) {
+    return stream->size - stream->used;
+}
+
+// Number of the len bytes from index that come before the buffer wraps.
+static size_t stream_first_part(const rtos_stream_t *stream, size_t index,
+                                size_t len)
+{
+    const size_t to_end = stream->size - index;
+    return len < to_end ? len : to_end;
+}
+
+static void stream_write(rtos_stream_t *stream, const void *src, size_t len) {
+    ASSERT(len <= stream_free(stream));
+    const size_t first = stream_first_part(stream, stream->head, len);
+    ring_copy(&stream->data[stream->head], src, first);
+    ring_copy(stream->data, (const uint8_t *)src + first, len - first);
+    stream->head = (stream->head + len) % stream->size;
+    stream->used += len;
+}
+
+static void stream_peek(const rtos_stream_t *stream, void *dst, size_t len) {
+    ASSERT(len <= stream->used);
+    const size_t first = stream_first_part(stream, stream->tail, len);
+    ring_copy(dst, &stream->data[stream->tail], first);
+    ring_copy((uint8_t *)dst + first, stream->data, len - first);
+}
+
+static void stream_discard(rtos_stream_t *stream, size_t len) {
+    ASSERT(len <= stream->used);
+    stream->tail = (stream->tail + len) % stream->size;
+    stream->used -= len;
+}
+
+static void stream_read(rtos_stream_t *stream, void *dst, size_t len) {
+    stream_peek(stream, dst, len);
+    stream_discard(stream, len);
+}
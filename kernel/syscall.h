@@ -0,0 +1,102 @@
+#pragma once
+
+#include "cortex_m4.h"
+#include "stack_frame.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+// System call ABI:
+// - The system call number is passed in R12 and the SVC immediate is ignored,
+//   so the handler never has to read the SVC instruction. With
+//   RTOS_ENABLE_SYSCALL_TABLE disabled, the number is the SVC immediate.
+// - Arguments are passed as for a normal function call. The first four are in
+//   R0-R3 and the rest are on the caller's stack, which the handler finds just
+//   above the exception frame.
+// - The return value is passed back in R0.
+// - Code that's already in handler mode calls the implementation directly
+//   instead of trapping.
+// Numbers from SYSCALL_DEBUG_BASE upwards are passed to debug_syscall() when
+// RTOS_DEBUG is defined.
+typedef enum {
+    SYSCALL_START,
+    SYSCALL_TASK_CREATE,
+    SYSCALL_TASK_EXIT,
+    SYSCALL_TASK_YIELD,
+    SYSCALL_TASK_SLEEP,
+    SYSCALL_TASK_SUSPEND,
+    SYSCALL_TASK_RESUME,
+    SYSCALL_TASK_JOIN,
+    SYSCALL_MUTEX_CREATE,
+    SYSCALL_MUTEX_DESTROY,
+    SYSCALL_MUTEX_LOCK,
+    SYSCALL_MUTEX_TRYLOCK,
+    SYSCALL_MUTEX_UNLOCK,
+    SYSCALL_COND_CREATE,
+    SYSCALL_COND_DESTROY,
+    SYSCALL_COND_WAIT,
+    SYSCALL_COND_SIGNAL,
+    SYSCALL_COND_BROADCAST,
+    SYSCALL_MQUEUE_CREATE,
+    SYSCALL_MQUEUE_DESTROY,
+    SYSCALL_MQUEUE_ENQUEUE,
+    SYSCALL_MQUEUE_DEQUEUE,
+    SYSCALL_TASK_SLEEP_UNTIL,
+    SYSCALL_TASK_GET_STATS,
+    SYSCALL_WORK_TAKE,
+    SYSCALL_TASK_RESCHEDULE,
+    SYSCALL_RING_WAIT,
+    SYSCALL_RING_WAKE,
+    SYSCALL_MQUEUE_RESERVE,
+    SYSCALL_MQUEUE_COMMIT,
+    SYSCALL_MQUEUE_ACQUIRE,
+    SYSCALL_MQUEUE_RELEASE,
+    SYSCALL_MQUEUE_ENQUEUE_N,
+    SYSCALL_MQUEUE_DEQUEUE_N,
+    SYSCALL_STREAM_SEND,
+    SYSCALL_STREAM_RECEIVE,
+    SYSCALL_TASK_JOIN_TIMED,
+    SYSCALL_MUTEX_LOCK_TIMED,
+    SYSCALL_COND_WAIT_TIMED,
+    SYSCALL_MQUEUE_ENQUEUE_TIMED,
+    SYSCALL_MQUEUE_DEQUEUE_TIMED,
+    SYSCALL_SEM_GIVE,
+    SYSCALL_SEM_TAKE,
+    SYSCALL_EVENT_GROUP_SET,
+    SYSCALL_EVENT_GROUP_CLEAR,
+    SYSCALL_EVENT_GROUP_WAIT,
+    SYSCALL_TASK_NOTIFY,
+    SYSCALL_TASK_NOTIFY_WAIT,
+    SYSCALL_SELECT_WAIT,
+    SYSCALL_RWLOCK_READ_LOCK,
+    SYSCALL_RWLOCK_READ_UNLOCK,
+    SYSCALL_RWLOCK_WRITE_LOCK,
+    SYSCALL_RWLOCK_WRITE_UNLOCK,
+    SYSCALL_MUTEX_CREATE_INHERIT,
+    SYSCALL_MSGBUF_DISCARD,
+    SYSCALL_MQUEUE_ENQUEUE_N_TIMED,
+    SYSCALL_MQUEUE_DEQUEUE_N_TIMED,
+    SYSCALL_COUNT,
+
+    SYSCALL_DEBUG_BASE = 128,
+} syscall_num_t;
+
+static_assert(SYSCALL_COUNT <= SYSCALL_DEBUG_BASE, "");
+
+// Implementations in the system call table take the registers from the
+// exception frame (or an equivalent frame for direct calls) and a pointer to
+// any arguments passed on the stack.
+typedef size_t (*syscall_func_t)(const exception_entry_stack_t *frame,
+                                 const size_t *stack_args);
+
+// Returns a pointer to the caller's stacked arguments, which are above the
+// exception frame and any padding added to align it.
+static inline const size_t *syscall_stack_args(
+    const exception_entry_stack_t *frame, uint32_t exc_return)
+{
+    size_t frame_words = (exc_return & cm4_exc_return_nofp_mask) ? 8 : 26;
+    if (frame->xpsr & cm4_xpsr_frame_padded_mask) {
+        ++frame_words;
+    }
+    return (const size_t *)frame + frame_words;
+}
@@ -4,6 +4,9 @@
 #include "rtos_assert.h"
 #include "stack_frame.h"
 
+#include <stddef.h>
+#include <stdint.h>
+
 // Instead directly entering the task function, a stub function is used which
 // calls the task function. This ensures that a task always exits properly.
 [[noreturn]] static void tcb_stub(void *arg, rtos_task_func_t task_func) {
@@ -39,16 +42,56 @@ static void tcb_init(rtos_tcb_t *tcb, const rtos_task_settings_t *settings) {
         .stack_low          = (size_t *)settings->stack_low,
         .priority           = settings->priority,
         .def_priority       = settings->priority,
-        .slice_left         = RTOS_TICKS_PER_SLICE,
-        .wake_time          = 0,
+        .base_priority      = settings->priority,
+        .deadline           = settings->deadline,
+        .wcet               = settings->wcet,
+        .policy             = settings->policy,
+        .time_slice         = settings->time_slice ?: RTOS_TICKS_PER_SLICE,
+        .slice_left         = settings->time_slice ?: RTOS_TICKS_PER_SLICE,
+        .budget             = settings->budget,
+        .budget_period      = settings->budget_period,
+        .budget_left        = settings->budget,
+        .timer              = {0},
         .state              = RTOS_TASKSTATE_READY,
         .waiting_to_join    = (rtos_tlist_t){.head = NULL, .tail = NULL},
+        .inherit_held       = NULL,
+        .period             = 0,
+        .stats              = {0},
+        .counters           = {0},
+        .notify_value       = 0,
         .privileged         = settings->privileged,
         .prev               = NULL,
         .next               = NULL,
     };
 }
 
+static bool tcb_is_edf(const rtos_tcb_t *tcb) {
+    return RTOS_ENABLE_EDF && tcb->priority == RTOS_EDF_PRIORITY;
+}
+
+// Returns whether task a should be scheduled before task b. Within the EDF
+// priority, tasks are ordered by absolute deadline. Tasks without a deadline
+// only end up at that priority while holding a mutex and go first.
+static bool tcb_runs_before(const rtos_tcb_t *a, const rtos_tcb_t *b) {
+    if (a->priority != b->priority || !tcb_is_edf(a)) {
+        return a->priority > b->priority;
+    }
+    if (a->deadline == 0 || b->deadline == 0) {
+        return a->deadline == 0 && b->deadline != 0;
+    }
+    return (ptrdiff_t)(a->abs_deadline - b->abs_deadline) < 0;
+}
+
+// FIFO tasks run until they block or yield, and deadline ordered tasks run in
+// deadline order, so neither are time-sliced.
+static bool tcb_is_time_sliced(const rtos_tcb_t *tcb) {
+    return tcb->policy == RTOS_SCHED_RR && !tcb_is_edf(tcb);
+}
+
 static void tcb_reset_slice(rtos_tcb_t *tcb) {
-    tcb->slice_left = RTOS_TICKS_PER_SLICE;
+    tcb->slice_left = tcb->time_slice;
+}
+
+static rtos_tcb_t *tcb_from_timer(rtos_timer_t *timer) {
+    return (rtos_tcb_t *)((uint8_t *)timer - offsetof(rtos_tcb_t, timer));
 }
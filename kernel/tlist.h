@@ -52,21 +52,37 @@ static void tlist_push_back(rtos_tlist_t *tlist, rtos_tcb_t *task) {
     }
 }
 
-static void tlist_insert_ascending(rtos_tlist_t *tlist, rtos_tcb_t *task) {
-    rtos_tcb_t *ptr = tlist->head;
-    while (ptr != NULL && ptr->wake_time < task->wake_time) {
-        ptr = ptr->next;
-    }
-    if (ptr == NULL) {
+// Inserts the task before pos, or at the back if pos is NULL.
+static void tlist_insert_before(rtos_tlist_t *tlist, rtos_tcb_t *pos,
+                                rtos_tcb_t *task)
+{
+    if (pos == NULL) {
         tlist_push_back(tlist, task);
     } else {
-        if (ptr->prev == NULL) {
+        if (pos->prev == NULL) {
             tlist->head = task;
         } else {
-            ptr->prev->next = task;
+            pos->prev->next = task;
         }
-        task->prev = ptr->prev;
-        task->next = ptr;
-        ptr->prev = task;
+        task->prev = pos->prev;
+        task->next = pos;
+        pos->prev = task;
+    }
+}
+
+static void tlist_remove(rtos_tlist_t *tlist, rtos_tcb_t *task) {
+    if (task->prev == NULL) {
+        ASSERT(tlist->head == task);
+        tlist->head = task->next;
+    } else {
+        task->prev->next = task->next;
+    }
+    if (task->next == NULL) {
+        ASSERT(tlist->tail == task);
+        tlist->tail = task->prev;
+    } else {
+        task->next->prev = task->prev;
     }
+    task->prev = NULL;
+    task->next = NULL;
 }
@@ -1,44 +1,135 @@
 #pragma once
 
+#include "cortex_m4.h"
 #include "rtos.h"
 #include "rtos_assert.h"
+#include "tcb.h"
 #include "tlist.h"
 
+#include <stdint.h>
+
+// Each priority level has a bit in the bitmap which is set whenever its list
+// is non-empty. The levels are split into groups of 32, and each group has a
+// bit in the group bitmap which is set whenever any of its levels are. This
+// allows the highest priority task to be found in constant time using two CLZ
+// instructions. Since it has a list per level, the tpq is only used for the
+// ready tasks. Wait lists are kept sorted by priority instead.
+static_assert(RTOS_NUM_PRIORITY_LEVELS <= 256,
+              "Priority bitmap only supports up to 256 levels");
+
+enum { TPQ_GROUPS = (RTOS_NUM_PRIORITY_LEVELS + 31) / 32 };
+
+typedef struct {
+    rtos_tlist_t tlists[RTOS_NUM_PRIORITY_LEVELS];
+    uint32_t groups;                // Bit N is set if bitmap[N] is non-zero
+    uint32_t bitmap[TPQ_GROUPS];    // Bit N % 32 of bitmap[N / 32] is set if
+                                    // tlists[N] is non-empty
+} rtos_tpq_t;
+
 static void tpq_init(rtos_tpq_t *tpq) {
     for (int i = 0; i < RTOS_NUM_PRIORITY_LEVELS; ++i) {
         tpq->tlists[i].head = NULL;
         tpq->tlists[i].tail = NULL;
     }
+    for (int i = 0; i < TPQ_GROUPS; ++i) {
+        tpq->bitmap[i] = 0;
+    }
+    tpq->groups = 0;
 }
 
-static bool tpq_is_empty(rtos_tpq_t *tpq) {
-    for (int i = 0; i < RTOS_NUM_PRIORITY_LEVELS; ++i) {
-        if (!tlist_is_empty(&tpq->tlists[i])) {
-            return false;
-        }
+static void tpq_set_bit(rtos_tpq_t *tpq, size_t priority) {
+    tpq->bitmap[priority / 32U] |= 1U << (priority % 32U);
+    tpq->groups |= 1U << (priority / 32U);
+}
+
+static void tpq_clear_bit(rtos_tpq_t *tpq, size_t priority) {
+    tpq->bitmap[priority / 32U] &= ~(1U << (priority % 32U));
+    if (tpq->bitmap[priority / 32U] == 0) {
+        tpq->groups &= ~(1U << (priority / 32U));
+    }
+}
+
+static bool tpq_is_empty(const rtos_tpq_t *tpq) {
+    return tpq->groups == 0;
+}
+
+static bool tpq_list_is_empty(const rtos_tpq_t *tpq, const rtos_tcb_t *task) {
+    const size_t priority = task->priority;
+    return (tpq->bitmap[priority / 32U] & (1U << (priority % 32U))) == 0;
+}
+
+// Returns whether there are any tasks with a priority strictly greater than
+// the given priority.
+static bool tpq_has_above(const rtos_tpq_t *tpq, size_t priority) {
+    return (tpq->groups >> (priority / 32U)) > 1U ||
+           (tpq->bitmap[priority / 32U] >> (priority % 32U)) > 1U;
+}
+
+// Returns whether any task in the tpq should be scheduled before the given
+// task.
+static bool tpq_has_higher(const rtos_tpq_t *tpq, const rtos_tcb_t *task) {
+    if (tpq_has_above(tpq, task->priority)) {
+        return true;
     }
-    return true;
+    return tcb_is_edf(task) && !tpq_list_is_empty(tpq, task) &&
+           tcb_runs_before(tpq->tlists[task->priority].head, task);
 }
 
-static bool tpq_list_is_empty(rtos_tpq_t *tpq, rtos_tcb_t *task) {
-    return tlist_is_empty(&tpq->tlists[task->priority]);
+// Must not be called on an empty tpq.
+static size_t tpq_highest_priority(const rtos_tpq_t *tpq) {
+    ASSERT(!tpq_is_empty(tpq));
+    const size_t group = 31U - cm4_count_leading_zeros(tpq->groups);
+    return group * 32U + 31U - cm4_count_leading_zeros(tpq->bitmap[group]);
+}
+
+// The EDF priority's list is kept sorted by deadline. Pushing to the front
+// places the task before others with the same deadline and pushing to the back
+// places it after them. This is O(n) in the number of EDF tasks in the list.
+static void tpq_insert_edf(rtos_tpq_t *tpq, rtos_tcb_t *task, bool front) {
+    rtos_tlist_t *const tlist = &tpq->tlists[task->priority];
+    rtos_tcb_t *pos = tlist->head;
+    while (pos != NULL && (front ? tcb_runs_before(pos, task)
+                                 : !tcb_runs_before(task, pos)))
+    {
+        pos = pos->next;
+    }
+    tlist_insert_before(tlist, pos, task);
 }
 
 static void tpq_push_front(rtos_tpq_t *tpq, rtos_tcb_t *task) {
-    tlist_push_front(&tpq->tlists[task->priority], task);
+    if (tcb_is_edf(task)) {
+        tpq_insert_edf(tpq, task, true);
+    } else {
+        tlist_push_front(&tpq->tlists[task->priority], task);
+    }
+    tpq_set_bit(tpq, task->priority);
 }
 
 static void tpq_push_back(rtos_tpq_t *tpq, rtos_tcb_t *task) {
-    tlist_push_back(&tpq->tlists[task->priority], task);
+    if (tcb_is_edf(task)) {
+        tpq_insert_edf(tpq, task, false);
+    } else {
+        tlist_push_back(&tpq->tlists[task->priority], task);
+    }
+    tpq_set_bit(tpq, task->priority);
 }
 
 static rtos_tcb_t *tpq_pop_front(rtos_tpq_t *tpq) {
-    rtos_tcb_t *task = NULL;
-    for (int i = RTOS_NUM_PRIORITY_LEVELS - 1; i >= 0; --i) {
-        if (!tlist_is_empty(&tpq->tlists[i])) {
-            task = tlist_pop_front(&tpq->tlists[i]);
-            break;
-        }
+    if (tpq_is_empty(tpq)) {
+        return NULL;
+    }
+    const size_t priority = tpq_highest_priority(tpq);
+    rtos_tcb_t *const task = tlist_pop_front(&tpq->tlists[priority]);
+    if (tlist_is_empty(&tpq->tlists[priority])) {
+        tpq_clear_bit(tpq, priority);
     }
     return task;
 }
+
+static void tpq_remove(rtos_tpq_t *tpq, rtos_tcb_t *task) {
+    rtos_tlist_t *const tlist = &tpq->tlists[task->priority];
+    tlist_remove(tlist, task);
+    if (tlist_is_empty(tlist)) {
+        tpq_clear_bit(tpq, task->priority);
+    }
+}
@@ -0,0 +1,201 @@
+#pragma once
+
+#include "cortex_m4.h"
+#include "rtos.h"
+#include "rtos_assert.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Timers are kept in a hierarchical timing wheel. Level 0 has one slot per
+// tick and each slot at level N spans 32^N ticks. A timer is placed in the
+// lowest level whose range covers its remaining delay. Whenever the tick count
+// crosses a slot boundary at a higher level, the timers in that slot are
+// cascaded into the lower levels. This makes inserting a timer O(1) and each
+// timer is moved at most once per level before it expires.
+//
+// Timers whose delay exceeds the range of the top level are placed in the top
+// level and are simply reinserted each time their slot comes around.
+
+enum {
+    WHEEL_SLOT_BITS = 5,
+    WHEEL_SLOTS     = 1 << WHEEL_SLOT_BITS,
+    WHEEL_SLOT_MASK = WHEEL_SLOTS - 1,
+};
+
+static_assert(RTOS_TIMER_WHEEL_LEVELS >= 1, "");
+static_assert(RTOS_TIMER_WHEEL_LEVELS * WHEEL_SLOT_BITS <= 32,
+              "Timer wheel levels exceed the range of the tick count");
+
+typedef struct rtos_timer_list {
+    rtos_timer_t *head;
+    rtos_timer_t *tail;
+} rtos_timer_list_t;
+
+typedef struct {
+    rtos_timer_list_t   slots[RTOS_TIMER_WHEEL_LEVELS][WHEEL_SLOTS];
+    uint32_t            occupied[RTOS_TIMER_WHEEL_LEVELS]; // Non-empty slots
+    rtos_timer_list_t   expired;
+} rtos_wheel_t;
+
+static void timer_list_push_back(rtos_timer_list_t *list, rtos_timer_t *timer) {
+    timer->list = list;
+    timer->next = NULL;
+    timer->prev = list->tail;
+    if (list->tail == NULL) {
+        list->head = timer;
+    } else {
+        list->tail->next = timer;
+    }
+    list->tail = timer;
+}
+
+static rtos_timer_t *timer_list_pop_front(rtos_timer_list_t *list) {
+    rtos_timer_t *const popped = list->head;
+    if (popped != NULL) {
+        list->head = popped->next;
+        if (list->head == NULL) {
+            list->tail = NULL;
+        } else {
+            list->head->prev = NULL;
+        }
+        popped->list = NULL;
+        popped->prev = NULL;
+        popped->next = NULL;
+    }
+    return popped;
+}
+
+static void timer_list_remove(rtos_timer_list_t *list, rtos_timer_t *timer) {
+    if (timer->prev == NULL) {
+        list->head = timer->next;
+    } else {
+        timer->prev->next = timer->next;
+    }
+    if (timer->next == NULL) {
+        list->tail = timer->prev;
+    } else {
+        timer->next->prev = timer->prev;
+    }
+    timer->list = NULL;
+    timer->prev = NULL;
+    timer->next = NULL;
+}
+
+// Returns whether `tick` is at or before `now`. The comparison is done on the
+// difference so that tick count overflow is handled.
+static bool tick_is_reached(size_t tick, size_t now) {
+    return (ptrdiff_t)(tick - now) <= 0;
+}
+
+static bool timer_is_due(const rtos_timer_t *timer, size_t now) {
+    return tick_is_reached(timer->wake_time, now);
+}
+
+static size_t wheel_level_shift(size_t level) {
+    return WHEEL_SLOT_BITS * level;
+}
+
+// Inserts a timer. `now` is the most recent tick that has been processed by
+// wheel_advance().
+static void wheel_insert(rtos_wheel_t *wheel, rtos_timer_t *timer, size_t now) {
+    const size_t delay = timer->wake_time - now;
+    size_t level = 0;
+    while (level + 1 < RTOS_TIMER_WHEEL_LEVELS &&
+           (delay >> wheel_level_shift(level + 1)) != 0)
+    {
+        ++level;
+    }
+    const size_t slot =
+        (timer->wake_time >> wheel_level_shift(level)) & WHEEL_SLOT_MASK;
+    timer_list_push_back(&wheel->slots[level][slot], timer);
+    wheel->occupied[level] |= 1U << slot;
+}
+
+// Processes the tick `now`. This must be one greater than the previous tick
+// processed unless wheel_next_expiry() reported that none of the skipped ticks
+// have any work. Timers that are due are moved to the expired list, in the
+// order that they were inserted.
+static void wheel_advance(rtos_wheel_t *wheel, size_t now) {
+    // Find the highest level with a slot boundary at this tick. Higher levels
+    // are processed first so that cascaded timers which are due at this tick
+    // end up in the level 0 slot before it's processed.
+    size_t top = 0;
+    while (top + 1 < RTOS_TIMER_WHEEL_LEVELS &&
+           (now & ((1U << wheel_level_shift(top + 1)) - 1)) == 0)
+    {
+        ++top;
+    }
+
+    for (size_t level = top + 1; level-- > 0;) {
+        const size_t slot = (now >> wheel_level_shift(level)) & WHEEL_SLOT_MASK;
+        if ((wheel->occupied[level] & (1U << slot)) == 0) {
+            continue;
+        }
+
+        rtos_timer_list_t pending = wheel->slots[level][slot];
+        wheel->slots[level][slot] = (rtos_timer_list_t){NULL, NULL};
+        wheel->occupied[level] &= ~(1U << slot);
+
+        rtos_timer_t *timer;
+        while ((timer = timer_list_pop_front(&pending)) != NULL) {
+            if (timer_is_due(timer, now)) {
+                timer_list_push_back(&wheel->expired, timer);
+            } else {
+                wheel_insert(wheel, timer, now);
+            }
+        }
+    }
+}
+
+// Returns the first slot index after `index` that's set in `occupied`, as a
+// distance in the range [1, WHEEL_SLOTS]. `occupied` must be non-zero.
+static size_t wheel_next_occupied(uint32_t occupied, size_t index) {
+    const size_t start = (index + 1) & WHEEL_SLOT_MASK;
+    const size_t wrap = (WHEEL_SLOTS - start) & WHEEL_SLOT_MASK;
+    const uint32_t rotated = (occupied >> start) | (occupied << wrap);
+    return cm4_count_trailing_zeros(rotated) + 1;
+}
+
+// Returns the number of ticks after `now` until wheel_advance() next has any
+// work to do, either expiring or cascading timers, capped at `limit`.
+static size_t wheel_next_expiry(const rtos_wheel_t *wheel, size_t now,
+                                size_t limit)
+{
+    size_t ticks = limit;
+    for (size_t level = 0; level < RTOS_TIMER_WHEEL_LEVELS; ++level) {
+        if (wheel->occupied[level] == 0) {
+            continue;
+        }
+        const size_t shift = wheel_level_shift(level);
+        const size_t distance = wheel_next_occupied(
+            wheel->occupied[level], (now >> shift) & WHEEL_SLOT_MASK);
+        const size_t slot_time = ((now >> shift) + distance) << shift;
+        if (slot_time - now < ticks) {
+            ticks = slot_time - now;
+        }
+    }
+    return ticks;
+}
+
+// Returns the next expired timer, or NULL if there are none.
+static rtos_timer_t *wheel_pop_expired(rtos_wheel_t *wheel) {
+    return timer_list_pop_front(&wheel->expired);
+}
+
+static bool wheel_contains(const rtos_timer_t *timer) {
+    return timer->list != NULL;
+}
+
+// Removes a timer before it expires. Its slot is marked empty if it was the
+// last timer there so that tickless idle doesn't wake for it.
+static void wheel_remove(rtos_wheel_t *wheel, rtos_timer_t *timer) {
+    ASSERT(wheel_contains(timer));
+    rtos_timer_list_t *const list = timer->list;
+    timer_list_remove(list, timer);
+    if (list != &wheel->expired && list->head == NULL) {
+        const size_t index = list - &wheel->slots[0][0];
+        wheel->occupied[index / WHEEL_SLOTS] &= ~(1U << (index % WHEEL_SLOTS));
+    }
+}
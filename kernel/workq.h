@@ -0,0 +1,49 @@
+#pragma once
+
+#include "cortex_m4.h"
+#include "rtos.h"
+#include "rtos_assert.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Pending work items are kept in a singly linked FIFO for each priority level.
+// Like the tpq, a bitmap records which levels are non-empty so that posting
+// and taking an item are both constant time.
+static_assert(RTOS_NUM_WORK_PRIORITY_LEVELS >= 1 &&
+              RTOS_NUM_WORK_PRIORITY_LEVELS <= 32,
+              "Work bitmap only supports up to 32 levels");
+
+typedef struct {
+    rtos_work_t *   heads[RTOS_NUM_WORK_PRIORITY_LEVELS];
+    rtos_work_t *   tails[RTOS_NUM_WORK_PRIORITY_LEVELS];
+    uint32_t        bitmap;
+} rtos_workq_t;
+
+static void workq_push_back(rtos_workq_t *workq, rtos_work_t *work) {
+    ASSERT(work->priority < RTOS_NUM_WORK_PRIORITY_LEVELS);
+    const size_t prio = work->priority;
+    work->next = NULL;
+    if (workq->bitmap & (1U << prio)) {
+        workq->tails[prio]->next = work;
+    } else {
+        workq->heads[prio] = work;
+        workq->bitmap |= 1U << prio;
+    }
+    workq->tails[prio] = work;
+}
+
+// Returns NULL if the workq is empty.
+static rtos_work_t *workq_pop_highest(rtos_workq_t *workq) {
+    if (workq->bitmap == 0) {
+        return NULL;
+    }
+    const size_t prio = 31U - cm4_count_leading_zeros(workq->bitmap);
+    rtos_work_t *const work = workq->heads[prio];
+    workq->heads[prio] = work->next;
+    if (work->next == NULL) {
+        workq->bitmap &= ~(1U << prio);
+    }
+    work->next = NULL;
+    return work;
+}
@@ -5,18 +5,30 @@
 #include <array>
 #include <cstddef>
 #include <cstdint>
+#include <span>
 #include <type_traits>
 
 namespace rtos {
 
 constexpr size_t ticks_per_slice = RTOS_TICKS_PER_SLICE;
+constexpr size_t wait_forever = RTOS_WAIT_FOREVER;
 
 [[noreturn]] inline void start() { rtos_start(); };
 
 inline void tick() { rtos_tick(); };
 
+inline uint64_t time_now() { return rtos_time_now(); }
+
+inline rtos_kernel_info_t kernel_info() {
+    rtos_kernel_info_t info;
+    rtos_kernel_info_get(&info);
+    return info;
+}
+
 struct Task : public rtos_tcb_t {
     using Settings = rtos_task_settings_t;
+    using Stats = rtos_task_stats_t;
+    using Counters = rtos_task_counters_t;
 
     Task() = default;
 
@@ -28,36 +40,88 @@ struct Task : public rtos_tcb_t {
 
 namespace task {
 
-    inline void create(Task &task, const Task::Settings &settings) {
-        rtos_task_create(&task, &settings);
+    inline bool create(Task &task, const Task::Settings &settings) {
+        return rtos_task_create(&task, &settings);
     }
     inline void yield() { rtos_task_yield(); }
     inline void sleep(size_t ticks) { rtos_task_sleep(ticks); }
+    inline void sleep_until(size_t &last_wake, size_t period) {
+        rtos_task_sleep_until(&last_wake, period);
+    }
     inline void suspend() { rtos_task_suspend(); }
     inline void resume(Task *task) { rtos_task_resume(task); }
     inline Task *self() { return reinterpret_cast<Task *>(rtos_task_self()); }
     [[noreturn]] inline void exit() { rtos_task_exit(); }
     inline void join(Task *task) { rtos_task_join(task); }
+    inline bool join_timed(Task *task, size_t timeout) {
+        return rtos_task_join_timed(task, timeout);
+    }
+    inline Task::Stats stats(const Task *task) {
+        Task::Stats stats;
+        rtos_task_get_stats(task, &stats);
+        return stats;
+    }
+    inline Task::Counters counters(const Task *task) {
+        Task::Counters counters;
+        rtos_task_get_counters(task, &counters);
+        return counters;
+    }
+    inline bool notify(Task *task, uint32_t value,
+                       rtos_notify_action_t action) {
+        return rtos_task_notify(task, value, action);
+    }
+    inline bool notify_isr(Task *task, uint32_t value,
+                           rtos_notify_action_t action) {
+        return rtos_task_notify_isr(task, value, action);
+    }
+    inline uint32_t notify_wait(bool clear) {
+        return rtos_task_notify_wait(clear);
+    }
+    inline uint32_t notify_wait_timed(bool clear, size_t timeout) {
+        return rtos_task_notify_wait_timed(clear, timeout);
+    }
 
 } // namespace task
 
+// Tag for creating a mutex that uses priority inheritance
+struct PriorityInheritance {};
+
 struct Mutex {
     rtos_mutex_t mutex;
 
     Mutex() { rtos_mutex_create(&mutex, RTOS_MAX_TASK_PRIORITY); }
     Mutex(size_t priority_ceil) { rtos_mutex_create(&mutex, priority_ceil); }
+    Mutex(PriorityInheritance) { rtos_mutex_create_inherit(&mutex); }
     ~Mutex() { rtos_mutex_destroy(&mutex); }
     void lock() { rtos_mutex_lock(&mutex); }
+    bool lock_timed(size_t timeout) {
+        return rtos_mutex_lock_timed(&mutex, timeout);
+    }
     void unlock() { rtos_mutex_unlock(&mutex); }
     bool trylock() { return rtos_mutex_trylock(&mutex); }
 };
 
+struct RwLock {
+    rtos_rwlock_t rwlock;
+
+    RwLock() { rtos_rwlock_create(&rwlock, RTOS_MAX_TASK_PRIORITY); }
+    RwLock(size_t priority_ceil) { rtos_rwlock_create(&rwlock, priority_ceil); }
+    ~RwLock() { rtos_rwlock_destroy(&rwlock); }
+    void read_lock() { rtos_rwlock_read_lock(&rwlock); }
+    void read_unlock() { rtos_rwlock_read_unlock(&rwlock); }
+    void write_lock() { rtos_rwlock_write_lock(&rwlock); }
+    void write_unlock() { rtos_rwlock_write_unlock(&rwlock); }
+};
+
 struct Cond {
     rtos_cond_t cond;
 
     Cond() { rtos_cond_create(&cond); }
     ~Cond() { rtos_cond_destroy(&cond); }
     void wait(Mutex &mutex) { rtos_cond_wait(&cond, &mutex.mutex); }
+    bool wait_timed(Mutex &mutex, size_t timeout) {
+        return rtos_cond_wait_timed(&cond, &mutex.mutex, timeout);
+    }
     void signal() { rtos_cond_signal(&cond); }
     void broadcast() { rtos_cond_broadcast(&cond); }
 };
@@ -69,7 +133,7 @@ struct Mqueue {
     static_assert(std::is_trivially_move_assignable_v<T>);
 
     rtos_mqueue_t mqueue;
-    std::array<uint8_t, slots * sizeof(T)> storage;
+    alignas(T) std::array<uint8_t, slots * sizeof(T)> storage;
 
     Mqueue() { rtos_mqueue_create(&mqueue, storage.data(), slots, sizeof(T)); }
     ~Mqueue() { rtos_mqueue_destroy(&mqueue); }
@@ -82,9 +146,172 @@ struct Mqueue {
         return *reinterpret_cast<T *>(raw);
     }
 
+    bool enqueue_timed(const T &data, size_t timeout) {
+        return rtos_mqueue_enqueue_timed(&mqueue, &data, timeout);
+    }
+    bool dequeue_timed(T &data, size_t timeout) {
+        return rtos_mqueue_dequeue_timed(&mqueue, &data, timeout);
+    }
+
     bool try_enqueue_isr(const T &data) {
         return rtos_mqueue_try_enqueue_isr(&mqueue, &data);
     }
+
+    // Both return the number of messages moved, which is at least min_count
+    size_t enqueue_n(std::span<const T> data, size_t min_count) {
+        return rtos_mqueue_enqueue_n(&mqueue, data.data(), data.size(),
+                                     min_count);
+    }
+    size_t dequeue_n(std::span<T> data, size_t min_count) {
+        return rtos_mqueue_dequeue_n(&mqueue, data.data(), data.size(),
+                                     min_count);
+    }
+
+    // Both return fewer than min_count messages if they time out
+    size_t enqueue_n_timed(std::span<const T> data, size_t min_count,
+                           size_t timeout) {
+        return rtos_mqueue_enqueue_n_timed(&mqueue, data.data(), data.size(),
+                                           min_count, timeout);
+    }
+    size_t dequeue_n_timed(std::span<T> data, size_t min_count,
+                           size_t timeout) {
+        return rtos_mqueue_dequeue_n_timed(&mqueue, data.data(), data.size(),
+                                           min_count, timeout);
+    }
+
+    // Messages are built and processed in place between these pairs
+    T *reserve() { return static_cast<T *>(rtos_mqueue_reserve(&mqueue)); }
+    void commit() { rtos_mqueue_commit(&mqueue); }
+    T *acquire() { return static_cast<T *>(rtos_mqueue_acquire(&mqueue)); }
+    void release() { rtos_mqueue_release(&mqueue); }
+};
+
+struct Semaphore {
+    rtos_sem_t sem;
+
+    Semaphore(size_t initial_count, size_t max_count) {
+        rtos_sem_create(&sem, initial_count, max_count);
+    }
+    ~Semaphore() { rtos_sem_destroy(&sem); }
+    void take() { rtos_sem_take(&sem); }
+    bool take_timed(size_t timeout) {
+        return rtos_sem_take_timed(&sem, timeout);
+    }
+    bool give() { return rtos_sem_give(&sem); }
+    bool give_isr() { return rtos_sem_give_isr(&sem); }
+};
+
+struct EventGroup {
+    rtos_event_group_t group;
+
+    EventGroup() { rtos_event_group_create(&group); }
+    ~EventGroup() { rtos_event_group_destroy(&group); }
+    void set(uint32_t flags) { rtos_event_group_set(&group, flags); }
+    void clear(uint32_t flags) { rtos_event_group_clear(&group, flags); }
+    void set_isr(uint32_t flags) { rtos_event_group_set_isr(&group, flags); }
+    void clear_isr(uint32_t flags) {
+        rtos_event_group_clear_isr(&group, flags);
+    }
+    uint32_t get() const { return rtos_event_group_get(&group); }
+    uint32_t wait(uint32_t flags, uint32_t options = 0) {
+        return rtos_event_group_wait(&group, flags, options);
+    }
+    uint32_t wait_timed(uint32_t flags, uint32_t options, size_t timeout) {
+        return rtos_event_group_wait_timed(&group, flags, options, timeout);
+    }
+};
+
+struct Select {
+    rtos_select_t select;
+
+    // The members must outlive the select
+    explicit Select(std::span<const rtos_select_member_t> members) {
+        rtos_select_create(&select, members.data(), members.size());
+    }
+    ~Select() { rtos_select_destroy(&select); }
+    // Both return the index of a member that is ready
+    size_t wait() { return rtos_select_wait(&select); }
+    size_t wait_timed(size_t timeout) {
+        return rtos_select_wait_timed(&select, timeout);
+    }
+};
+
+template<size_t size>
+struct Stream {
+    rtos_stream_t stream;
+    std::array<uint8_t, size> storage;
+
+    explicit Stream(size_t trigger = 1) {
+        rtos_stream_create(&stream, storage.data(), size, trigger);
+    }
+    ~Stream() { rtos_stream_destroy(&stream); }
+
+    void send(std::span<const uint8_t> data) {
+        rtos_stream_send(&stream, data.data(), data.size());
+    }
+    size_t receive(std::span<uint8_t> data) {
+        return rtos_stream_receive(&stream, data.data(), data.size());
+    }
+    size_t send_isr(std::span<const uint8_t> data) {
+        return rtos_stream_send_isr(&stream, data.data(), data.size());
+    }
+    size_t receive_isr(std::span<uint8_t> data) {
+        return rtos_stream_receive_isr(&stream, data.data(), data.size());
+    }
+};
+
+template<size_t size>
+struct MessageBuffer {
+    rtos_msgbuf_t msgbuf;
+    std::array<uint8_t, size> storage;
+
+    MessageBuffer() { rtos_msgbuf_create(&msgbuf, storage.data(), size); }
+    ~MessageBuffer() { rtos_msgbuf_destroy(&msgbuf); }
+
+    void send(std::span<const uint8_t> data) {
+        rtos_msgbuf_send(&msgbuf, data.data(), data.size());
+    }
+    // Returns 0 and leaves the message if it doesn't fit in data
+    size_t receive(std::span<uint8_t> data) {
+        return rtos_msgbuf_receive(&msgbuf, data.data(), data.size());
+    }
+    bool send_isr(std::span<const uint8_t> data) {
+        return rtos_msgbuf_send_isr(&msgbuf, data.data(), data.size());
+    }
+    size_t receive_isr(std::span<uint8_t> data) {
+        return rtos_msgbuf_receive_isr(&msgbuf, data.data(), data.size());
+    }
+    // Returns the length of the message removed, or 0 if there wasn't one
+    size_t discard() { return rtos_msgbuf_discard(&msgbuf); }
+};
+
+template<typename T, size_t slots>
+struct Ring {
+    static_assert(std::is_trivially_copyable_v<T>);
+
+    rtos_ring_t ring;
+    alignas(4) std::array<uint8_t, slots * sizeof(T)> storage;
+
+    Ring() { rtos_ring_create(&ring, storage.data(), slots, sizeof(T)); }
+    ~Ring() { rtos_ring_destroy(&ring); }
+
+    bool try_write(const T &data) { return rtos_ring_try_write(&ring, &data); }
+    bool try_read(T &data) { return rtos_ring_try_read(&ring, &data); }
+
+    T read() {
+        T data;
+        rtos_ring_read(&ring, &data);
+        return data;
+    }
+};
+
+struct Work {
+    rtos_work_t work;
+
+    Work(void (*func)(void *), void *arg, size_t priority) {
+        rtos_work_init(&work, func, arg, priority);
+    }
+    bool post_isr() { return rtos_work_post_isr(&work); }
 };
 
 } // namespace rtos
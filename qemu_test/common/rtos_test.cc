@@ -16,6 +16,12 @@ struct FailArgs {
     int line;
 };
 
+struct BenchArgs {
+    const char *name;
+    size_t name_len;
+    uint32_t value;
+};
+
 struct CheckPointArgs {
     int num;
     const char *file;
@@ -24,7 +30,10 @@ struct CheckPointArgs {
 
 TIM_HandleTypeDef htim2;
 std::optional<void(*)()> timer_callback;
+std::optional<void(*)()> high_priority_callback;
+std::optional<void(*)()> context_switch_callback;
 bool hardfault_expected = false;
+volatile uint32_t systick_interrupts = 0;
 
 [[noreturn]] void test_finished() {
     puts("<Test finished>");
@@ -59,16 +68,30 @@ void uart_init() {
     HAL_UART_Init(&huart);
 }
 
+void cycle_counter_init() {
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CYCCNT = 0;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+}
+
 void configure_nvic_for_rtos() {
     HAL_NVIC_SetPriorityGrouping(NVIC_PRIORITYGROUP_4);
     HAL_NVIC_SetPriority(SVCall_IRQn, 7, 0);
     HAL_NVIC_SetPriority(TIM2_IRQn, 8, 0);
+    static_assert(2 < RTOS_MAX_SYSCALL_IRQ_PRIORITY);
+    HAL_NVIC_SetPriority(TIM3_IRQn, 2, 0);
+    HAL_NVIC_EnableIRQ(TIM3_IRQn);
     HAL_NVIC_SetPriority(SysTick_IRQn, 14, 0);
     HAL_NVIC_SetPriority(PendSV_IRQn, 15, 0); // Lowest possible priority
 }
 
+// Debug system calls pass their number in both R12 and the SVC instruction so
+// that they work with either system call ABI.
 [[noreturn, gnu::naked]] void test_failed_syscall(const FailArgs &args) {
-    asm volatile("svc 130");
+    asm volatile(
+        "mov r12, #130  \n"
+        "svc 130        \n"
+    );
 }
 
 [[noreturn]] void test_failed(const FailArgs &args) {
@@ -85,11 +108,25 @@ void test_passed() {
 
 [[gnu::naked]] void checkpoint_syscall(const CheckPointArgs &args) {
     asm volatile(
-        "svc 128    \n"
-        "bx lr      \n"
+        "mov r12, #128  \n"
+        "svc 128        \n"
+        "bx lr          \n"
+    );
+}
+
+[[gnu::naked]] void report_bench_syscall(const BenchArgs &args) {
+    asm volatile(
+        "mov r12, #131  \n"
+        "svc 131        \n"
+        "bx lr          \n"
     );
 }
 
+void report_bench(const BenchArgs &args) {
+    std::printf("Bench: %.*s: %lu\r\n", static_cast<int>(args.name_len),
+                args.name, static_cast<unsigned long>(args.value));
+}
+
 void checkpoint(const CheckPointArgs &args) {
     static volatile int last = 0;
     if (args.num != last + 1) {
@@ -110,6 +147,7 @@ void rtos_test::setup() {
     HAL_Init();
     uart_init();
     tim2_init();
+    cycle_counter_init();
     configure_nvic_for_rtos();
 }
 
@@ -121,6 +159,42 @@ void rtos_test::start_timer() {
     HAL_TIM_Base_Start_IT(&htim2);
 }
 
+void rtos_test::trigger_timer() {
+    HAL_NVIC_SetPendingIRQ(TIM2_IRQn);
+    __DSB();
+    __ISB();
+}
+
+void rtos_test::set_high_priority_callback(void (*callback)()) {
+    high_priority_callback = callback;
+}
+
+void rtos_test::trigger_high_priority_interrupt() {
+    HAL_NVIC_SetPendingIRQ(TIM3_IRQn);
+    __DSB();
+    __ISB();
+}
+
+void rtos_test::set_context_switch_callback(void (*callback)()) {
+    context_switch_callback = callback;
+}
+
+uint32_t rtos_test::timer_counter() {
+    return __HAL_TIM_GET_COUNTER(&htim2);
+}
+
+uint32_t rtos_test::systick_count() {
+    return systick_interrupts;
+}
+
+uint32_t rtos_test::cycle_count() {
+    return DWT->CYCCNT;
+}
+
+void rtos_test::report_bench(std::string_view name, uint32_t value) {
+    report_bench_syscall({name.data(), name.size(), value});
+}
+
 void rtos_test::checkpoint(int num, std::source_location location) {
     checkpoint_syscall({
         num,
@@ -130,7 +204,10 @@ void rtos_test::checkpoint(int num, std::source_location location) {
 }
 
 [[gnu::naked]] void rtos_test::pass() {
-    asm volatile("svc 129");
+    asm volatile(
+        "mov r12, #129  \n"
+        "svc 129        \n"
+    );
 }
 
 void rtos_test::expect_hardfault_to_pass(void (*func)()) {
@@ -178,6 +255,9 @@ size_t debug_syscall(void *arg, int svc_num) {
         case 130:
             test_failed(*reinterpret_cast<FailArgs *>(arg));
             break;
+        case 131:
+            report_bench(*reinterpret_cast<BenchArgs *>(arg));
+            break;
         default:
             break;
     }
@@ -185,9 +265,16 @@ size_t debug_syscall(void *arg, int svc_num) {
     return 0;
 }
 
+void debug_context_switch() {
+    if (context_switch_callback.has_value()) {
+        context_switch_callback.value()();
+    }
+}
+
 // Interrupt handlers
 
 void SysTick_Handler(void) {
+    systick_interrupts = systick_interrupts + 1;
     HAL_IncTick();
     rtos::tick();
 }
@@ -199,6 +286,12 @@ void TIM2_IRQHandler(void) {
     __HAL_TIM_CLEAR_IT(&htim2, TIM_IT_UPDATE);
 }
 
+void TIM3_IRQHandler(void) {
+    if (high_priority_callback.has_value()) {
+        high_priority_callback.value()();
+    }
+}
+
 #define FAULT_HANDLER(fault_name) \
     void fault_name##_Handler() { \
         puts(#fault_name); \
@@ -5,6 +5,7 @@
 #include "stm32f4xx_hal.h" // IWYU pragma: export
 
 #include <cstddef>
+#include <cstdint>
 #include <source_location>
 #include <string_view>
 
@@ -17,33 +18,64 @@
 
 namespace rtos_test {
 
+// Settings for a test task. Fields that aren't given keep their defaults, so
+// tests only name the settings they care about.
+struct TaskSettings {
+    size_t priority;
+    bool privileged = false;
+    size_t deadline = 0;
+    size_t wcet = 0;
+    rtos_sched_policy_t policy = RTOS_SCHED_RR;
+    size_t time_slice = 0;
+    size_t budget = 0;
+    size_t budget_period = 0;
+};
+
 template<size_t stack_size = 512>
 struct TaskWithStack : public rtos::Task {
     static_assert(stack_size % 8 == 0, "Stack size must be a multiple of 8");
     static_assert(stack_size >= 256, "Stack size must be at least 256 bytes");
 
+    // The task is created later with create().
+    TaskWithStack() = default;
+
+    [[nodiscard]] TaskWithStack(const TaskSettings &settings, void (*func)()) {
+        create(settings, func);
+    }
+
     [[nodiscard]] TaskWithStack(size_t priority, bool privileged, void *arg,
                                 rtos_task_func_t func)
     {
-        rtos::task::create(*this, {
+        create({.priority = priority, .privileged = privileged}, arg, func);
+    }
+
+    [[nodiscard]] TaskWithStack(size_t priority, bool privileged, void (*func)())
+        : TaskWithStack({.priority = priority, .privileged = privileged}, func)
+    {}
+
+    // Returns whether the task was created.
+    bool create(const TaskSettings &settings, void *arg,
+                rtos_task_func_t func)
+    {
+        return rtos::task::create(*this, {
             .function = func,
             .task_arg = arg,
             .stack_low = stack.data(),
             .stack_size = stack.size(),
-            .priority = priority,
-            .privileged = false,
+            .priority = settings.priority,
+            .privileged = settings.privileged,
+            .deadline = settings.deadline,
+            .wcet = settings.wcet,
+            .policy = settings.policy,
+            .time_slice = settings.time_slice,
+            .budget = settings.budget,
+            .budget_period = settings.budget_period,
         });
     }
 
-    [[nodiscard]] TaskWithStack(size_t priority, bool privileged, void (*func)()) {
-        rtos::task::create(*this, {
-            .function = reinterpret_cast<rtos_task_func_t>(func),
-            .task_arg = nullptr,
-            .stack_low = stack.data(),
-            .stack_size = stack.size(),
-            .priority = priority,
-            .privileged = false,
-        });
+    bool create(const TaskSettings &settings, void (*func)()) {
+        return create(settings, nullptr,
+                      reinterpret_cast<rtos_task_func_t>(func));
     }
 
     alignas(8) std::array<std::byte, stack_size> stack;
@@ -55,6 +87,34 @@ void set_timer_callback(void (*callback)());
 
 void start_timer();
 
+// Makes the timer's interrupt pending without waiting for the timer.
+void trigger_timer();
+
+// TIM3's interrupt has a priority above RTOS_MAX_SYSCALL_IRQ_PRIORITY so its
+// callback must not call RTOS functions, including checkpoint() and EXPECT().
+void set_high_priority_callback(void (*callback)());
+
+void trigger_high_priority_interrupt();
+
+// Called at the start of every context switch from PendSV while the kernel has
+// interrupts masked. Like the high priority callback, it must not call RTOS
+// functions.
+void set_context_switch_callback(void (*callback)());
+
+// Value of the timer's counter which counts up at 1 kHz and wraps at 1000.
+uint32_t timer_counter();
+
+// Number of SysTick interrupts taken since setup().
+uint32_t systick_count();
+
+// Number of processor cycles since setup() measured with the DWT cycle
+// counter. Unlike SysTick, it keeps counting in handlers that mask SysTick.
+uint32_t cycle_count();
+
+// Prints a benchmark result. The tester shows these lines separately from the
+// test's expected output.
+void report_bench(std::string_view name, uint32_t value);
+
 [[noreturn]] void pass();
 
 [[noreturn]] void expect_hardfault_to_pass(void (*func)());
@@ -4,21 +4,26 @@ import os
 import signal
 import subprocess
 import sys
-from typing import List, Optional
+from typing import Dict, List, Optional
 
 TESTS: List[str] = [
     "test_sanity",
     "test_starting_rtos_enters_first_task",
     "test_task_self",
+    "test_kernel_info",
     "test_passing_arg",
     "test_context_switch_regs",
     "test_two_tasks_yielding",
     "test_basic_sleep",
     "test_task_sleep_wake_ordering_based_on_time",
     "test_task_sleep_wake_ordering_based_on_priority",
+    "test_task_sleep_long_durations",
+    "test_task_sleep_until",
     "test_starved_task",
+    "test_budget_throttling",
     "test_task_exit",
     "test_time_slicing",
+    "test_sched_policy",
     "test_basic_task_join",
     "test_fp_context_switch",
     "test_mutex_sanity",
@@ -27,16 +32,65 @@ TESTS: List[str] = [
     "test_mutex_aquire_order_based_on_priority",
     "test_mutex_priority_change",
     "test_mutex_ipcp_prevents_priority_inversion_deadlock",
+    "test_mutex_fast_path_ceiling",
+    "test_mutex_bench",
+    "test_mutex_bench_syscall",
+    "test_syscall_bench",
+    "test_syscall_bench_switch",
     "test_basic_suspend_resume",
     "test_cond_signal",
     "test_cond_broadcast",
     "test_privilege_disable_irq",
+    "test_critical_section",
     "test_mqueue_basic",
     "test_mqueue_waiting",
     "test_mqueue_wait_enqueue",
     "test_mqueue_try_enqueue_isr",
+    "test_mqueue_zero_copy",
+    "test_mqueue_batch",
+    "test_mqueue_batch_timed",
+    "test_stream_buffer",
+    "test_timed_waits",
+    "test_event_group",
+    "test_semaphore",
+    "test_syscall_result_isr",
+    "test_task_notify",
+    "test_select",
+    "test_select_multiple_waiters",
+    "test_mqueue_wake_order_based_on_priority",
+    "test_mqueue_enqueue_order_based_on_priority",
+    "test_cond_wake_order_based_on_priority",
+    "test_join_wake_order_based_on_priority",
+    "test_rwlock_concurrent_readers",
+    "test_rwlock_writer_hand_off",
+    "test_rwlock_ceiling",
+    "test_mutex_inherit_boosts_on_contention",
+    "test_mutex_inherit_chain",
+    "test_mutex_inherit_reorders_waiter",
+    "test_256_priority_levels",
+    "test_ring_bench",
+    "test_deferred_work",
+    "test_tickless_idle",
+    "test_edf_scheduling",
 ]
 
+# Kernel configuration macros for tests that need a non-default configuration
+TEST_DEFINES: Dict[str, List[str]] = {
+    "test_tickless_idle": ["RTOS_ENABLE_TICKLESS_IDLE=1"],
+    "test_edf_scheduling": ["RTOS_ENABLE_EDF=1", "RTOS_EDF_PRIORITY=1",
+                            "RTOS_ENABLE_EDF_ADMISSION=1"],
+    "test_deferred_work": ["RTOS_ENABLE_DEFERRED_WORK=1"],
+    "test_mutex_bench_syscall": ["RTOS_ENABLE_MUTEX_FAST_PATH=0"],
+    "test_256_priority_levels": ["RTOS_NUM_PRIORITY_LEVELS=256"],
+    "test_syscall_bench_switch": ["RTOS_ENABLE_SYSCALL_TABLE=0"],
+}
+
+# Tests that are built from another test's source with their own TEST_DEFINES
+TEST_SOURCES: Dict[str, str] = {
+    "test_mutex_bench_syscall": "test_mutex_bench",
+    "test_syscall_bench_switch": "test_syscall_bench",
+}
+
 class Ansi(StrEnum):
     BOLD = "\033[1m"
     GREEN = "\033[92m"
@@ -70,9 +124,13 @@ def run_qemu(test: str, output_q: mp.Queue, qemu_pid_q: mp.Queue) -> None:
 
 def build_test(test: str, optimize: bool) -> Optional[str]:
     oflags: str = "-O2 -flto" if optimize else "-O0"
+    defines: str = " ".join(TEST_DEFINES.get(test, []))
+    source: str = TEST_SOURCES.get(test, test)
     result = subprocess.run(
         ["make", f"-j{os.cpu_count()}", f"TEST_NAME={test}",
-         "TARGET_BOARD=F405", f"OPTIMIZE_FLAGS={oflags}"],
+         f"TEST_SOURCE={source}",
+         "TARGET_BOARD=F405", f"OPTIMIZE_FLAGS={oflags}",
+         f"TEST_DEFINES={defines}"],
         cwd=os.path.dirname(os.path.abspath(__file__)),
         stdout=subprocess.PIPE, 
         stderr=subprocess.PIPE, 
@@ -108,6 +166,14 @@ def run_test(test: str, optimize: bool) -> bool:
         print("Test timed out")
     else:
         output: str = output_q.get()
+
+        # Benchmark results are reported but don't affect the result.
+        lines: List[str] = output.splitlines(keepends=True)
+        for line in lines:
+            if line.startswith("Bench:"):
+                print(line.rstrip())
+        output = "".join(l for l in lines if not l.startswith("Bench:"))
+
         if (output == "Pass\n"):
             passed = True
         else:
@@ -0,0 +1,50 @@
+#include "rtos.hh"
+#include "rtos_test.hh"
+
+#include <optional>
+
+static_assert(RTOS_MAX_TASK_PRIORITY == 255);
+
+namespace {
+
+std::optional<rtos::Mutex> mutex;
+
+} // namespace
+
+int main() {
+    rtos_test::setup();
+
+    mutex.emplace(RTOS_MAX_TASK_PRIORITY);
+
+    // Each priority is in a different group of 32 levels
+    rtos_test::TaskWithStack task_top(255, false, []{
+        rtos_test::checkpoint(1);
+        rtos::task::sleep(10);
+        rtos_test::checkpoint(6);
+        mutex->lock();
+        rtos_test::checkpoint(8);
+        mutex->unlock();
+        rtos_test::pass();
+    });
+
+    rtos_test::TaskWithStack task_mid(100, false, []{
+        rtos_test::checkpoint(2);
+        rtos::task::sleep(5);
+        rtos_test::checkpoint(4);
+        mutex->lock();
+        rtos::task::sleep(10);
+        rtos_test::checkpoint(7);
+        mutex->unlock();
+        rtos_test::fail("Unlocking should have been preempted");
+    });
+
+    rtos_test::TaskWithStack task_low(31, false, []{
+        rtos_test::checkpoint(3);
+        rtos::task::sleep(7);
+        rtos_test::checkpoint(5);
+        rtos::task::sleep(100);
+        rtos_test::fail("Should not be reached");
+    });
+
+    rtos::start();
+}
@@ -0,0 +1,55 @@
+#include "rtos.hh"
+#include "rtos_test.hh"
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+
+namespace {
+
+constexpr size_t budget = 5;
+constexpr size_t budget_period = 20;
+constexpr uint32_t run_ticks = 100;
+
+std::optional<rtos_test::TaskWithStack<>> hog;
+
+} // namespace
+
+int main() {
+    rtos_test::setup();
+
+    // Without a budget this task would starve every lower priority task, as
+    // in test_starved_task.
+    hog.emplace(rtos_test::TaskSettings{
+        .priority = 2,
+        .budget = budget,
+        .budget_period = budget_period,
+    }, []{
+        while (true) {}
+    });
+
+    rtos_test::TaskWithStack low_priority_task(1, false, []{
+        // Count the ticks in which this task got to run.
+        const uint32_t start = HAL_GetTick();
+        uint32_t last = start;
+        uint32_t ticks_seen = 0;
+        while (HAL_GetTick() - start < run_ticks) {
+            const uint32_t now = HAL_GetTick();
+            if (now != last) {
+                ++ticks_seen;
+                last = now;
+            }
+        }
+
+        // The hog only gets its budget each period.
+        constexpr uint32_t periods = run_ticks / budget_period;
+        EXPECT(ticks_seen >= run_ticks - (periods + 1) * budget);
+
+        const rtos::Task::Stats stats = rtos::task::stats(&hog.value());
+        EXPECT(stats.throttles >= periods);
+        EXPECT(stats.budget_left <= budget);
+        rtos_test::pass();
+    });
+
+    rtos::start();
+}
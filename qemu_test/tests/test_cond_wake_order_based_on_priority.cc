@@ -0,0 +1,53 @@
+#include "rtos.hh"
+#include "rtos_test.hh"
+
+#include <optional>
+
+namespace {
+
+std::optional<rtos::Mutex> mutex;
+std::optional<rtos::Cond> cond;
+
+} // namespace
+
+int main() {
+    rtos_test::setup();
+
+    mutex.emplace();
+    cond.emplace();
+
+    rtos_test::TaskWithStack task0(0, false, []{
+        rtos_test::checkpoint(2);
+        rtos::task::sleep(10);
+        rtos_test::checkpoint(4);
+        mutex->lock();
+        cond->signal();
+        mutex->unlock();
+        rtos_test::checkpoint(6);
+        mutex->lock();
+        cond->signal();
+        mutex->unlock();
+        rtos_test::fail("Should not be reached");
+    });
+
+    rtos_test::TaskWithStack task1(1, false, []{
+        rtos_test::checkpoint(1);
+        mutex->lock();
+        cond->wait(*mutex);
+        rtos_test::checkpoint(7);
+        mutex->unlock();
+        rtos_test::pass();
+    });
+
+    rtos_test::TaskWithStack task2(2, false, []{
+        rtos::task::sleep(5);
+        rtos_test::checkpoint(3);
+        mutex->lock();
+        // Started waiting after task1 but is signalled first
+        cond->wait(*mutex);
+        rtos_test::checkpoint(5);
+        mutex->unlock();
+    });
+
+    rtos::start();
+}
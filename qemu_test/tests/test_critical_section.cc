@@ -0,0 +1,80 @@
+#include "rtos_test.hh"
+
+namespace {
+
+volatile int high_priority_count = 0;
+volatile int timer_count = 0;
+volatile bool switch_armed = false;
+volatile int high_priority_count_in_switch = -1;
+volatile int timer_count_in_switch = -1;
+
+} // namespace
+
+int main() {
+    rtos_test::setup();
+
+    rtos_test::set_high_priority_callback([]{
+        high_priority_count = high_priority_count + 1;
+    });
+
+    rtos_test::set_timer_callback([]{
+        timer_count = timer_count + 1;
+    });
+
+    rtos_test::set_context_switch_callback([]{
+        if (switch_armed) {
+            switch_armed = false;
+            rtos_test::trigger_high_priority_interrupt();
+            rtos_test::trigger_timer();
+            high_priority_count_in_switch = high_priority_count;
+            timer_count_in_switch = timer_count;
+        }
+    });
+
+    rtos_test::TaskWithStack task0(0, true, []{
+        rtos_test::checkpoint(1);
+
+        // Nothing can be checked with EXPECT() inside the critical section
+        // since it makes a system call.
+        rtos_critical_enter();
+        rtos_critical_enter();
+        rtos_test::trigger_high_priority_interrupt();
+        rtos_test::trigger_timer();
+        const int high_priority_count_in_critical = high_priority_count;
+        rtos_critical_exit();
+        const int timer_count_in_nested_critical = timer_count;
+        rtos_critical_exit();
+
+        EXPECT(high_priority_count_in_critical == 1);
+        EXPECT(timer_count_in_nested_critical == 0);
+        EXPECT(timer_count == 1);
+
+        // Exiting restores a BASEPRI that was raised before entering
+        __set_BASEPRI(8 << (8 - __NVIC_PRIO_BITS));
+        rtos_critical_enter();
+        rtos_critical_exit();
+        rtos_test::trigger_timer();
+        const int timer_count_with_basepri = timer_count;
+        __set_BASEPRI(0);
+        EXPECT(timer_count_with_basepri == 1);
+        EXPECT(timer_count == 2);
+        rtos_test::checkpoint(2);
+
+        switch_armed = true;
+        rtos::task::yield();
+        rtos_test::fail("Should not be reached");
+    });
+
+    rtos_test::TaskWithStack task1(0, false, []{
+        rtos_test::checkpoint(3);
+
+        // The high priority interrupt preempted the context switch while the
+        // timer interrupt had to wait for it to finish.
+        EXPECT(high_priority_count_in_switch == 2);
+        EXPECT(timer_count_in_switch == 2);
+        EXPECT(timer_count == 3);
+        rtos_test::pass();
+    });
+
+    rtos::start();
+}
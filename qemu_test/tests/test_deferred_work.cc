@@ -0,0 +1,55 @@
+#include "rtos_test.hh"
+
+#include <optional>
+
+namespace {
+
+std::optional<rtos::Work> low_work;
+std::optional<rtos::Work> mid_work;
+std::optional<rtos::Work> high_work;
+volatile bool done = false;
+
+} // namespace
+
+int main() {
+    rtos_test::setup();
+
+    high_work.emplace([](void *arg) {
+        EXPECT(arg == &high_work);
+        rtos_test::checkpoint(4);
+    }, &high_work, RTOS_NUM_WORK_PRIORITY_LEVELS - 1);
+
+    mid_work.emplace([](void *) {
+        rtos_test::checkpoint(5);
+    }, nullptr, 1);
+
+    low_work.emplace([](void *) {
+        rtos_test::checkpoint(6);
+        done = true;
+    }, nullptr, 0);
+
+    rtos_test::TaskWithStack task0(0, false, []{
+        rtos_test::checkpoint(1);
+        rtos_test::start_timer();
+        while (!done) {}
+        rtos_test::checkpoint(7);
+        rtos_test::pass();
+    });
+
+    rtos_test::set_timer_callback([]{
+        static int count = 0;
+        if (count == 0) {
+            // The work only runs once the interrupt returns, highest priority
+            // first regardless of the order it was posted in.
+            rtos_test::checkpoint(2);
+            EXPECT(low_work->post_isr());
+            EXPECT(high_work->post_isr());
+            EXPECT(mid_work->post_isr());
+            EXPECT(!high_work->post_isr());
+            rtos_test::checkpoint(3);
+        }
+        ++count;
+    });
+
+    rtos::start();
+}
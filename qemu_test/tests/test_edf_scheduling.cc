@@ -0,0 +1,69 @@
+#include "rtos.hh"
+#include "rtos_test.hh"
+
+#include <cstddef>
+
+// Built with RTOS_ENABLE_EDF=1, RTOS_EDF_PRIORITY=1, and
+// RTOS_ENABLE_EDF_ADMISSION=1
+
+namespace {
+
+rtos_test::TaskWithStack<> task_a;
+rtos_test::TaskWithStack<> task_b;
+rtos_test::TaskWithStack<> task_c;
+rtos_test::TaskWithStack<> task_d;
+
+constexpr rtos_test::TaskSettings deadline_settings(size_t deadline,
+                                                   size_t wcet)
+{
+    return {.priority = RTOS_EDF_PRIORITY, .deadline = deadline, .wcet = wcet};
+}
+
+void task_d_func() {
+    rtos_test::checkpoint(7);
+}
+
+} // namespace
+
+int main() {
+    rtos_test::setup();
+
+    // Fixed priority tasks above the band run first.
+    rtos_test::TaskWithStack high(2, false, []{
+        rtos_test::checkpoint(1);
+    });
+
+    // Utilization 5/30
+    EXPECT(task_a.create(deadline_settings(30, 5), []{
+        rtos_test::checkpoint(4);
+        // Task B wakes with an earlier deadline and preempts.
+        HAL_Delay(10);
+        rtos_test::checkpoint(6);
+        // Task B and C have exited so task D now fits.
+        EXPECT(task_d.create(deadline_settings(10, 2), task_d_func));
+        rtos_test::checkpoint(8);
+    }));
+
+    // Utilization 5/20
+    EXPECT(task_b.create(deadline_settings(20, 5), []{
+        rtos_test::checkpoint(3);
+        rtos::task::sleep(5);
+        rtos_test::checkpoint(5);
+    }));
+
+    // Utilization 5/10
+    EXPECT(task_c.create(deadline_settings(10, 5), []{
+        rtos_test::checkpoint(2);
+    }));
+
+    // Utilization 2/10 would exceed 100% in total.
+    EXPECT(!task_d.create(deadline_settings(10, 2), task_d_func));
+
+    // Fixed priority tasks below the band only run once it's empty.
+    rtos_test::TaskWithStack low(0, false, []{
+        rtos_test::checkpoint(9);
+        rtos_test::pass();
+    });
+
+    rtos::start();
+}
@@ -0,0 +1,53 @@
+#include "rtos.hh"
+#include "rtos_test.hh"
+
+#include <cstdint>
+#include <optional>
+
+namespace {
+
+std::optional<rtos::EventGroup> events;
+
+} // namespace
+
+int main() {
+    rtos_test::setup();
+
+    events.emplace();
+
+    rtos_test::set_timer_callback([]{
+        events->set_isr(0x1);
+    });
+
+    rtos_test::TaskWithStack task_all(2, false, []{
+        rtos_test::checkpoint(1);
+        const uint32_t flags =
+            events->wait(0x3, RTOS_EVENT_WAIT_ALL | RTOS_EVENT_CLEAR_ON_EXIT);
+        rtos_test::checkpoint(5);
+        EXPECT(flags == 0x3);
+        // Cleared only after every waiter was checked against both flags
+        EXPECT(events->get() == 0);
+
+        EXPECT(events->wait_timed(0x8, 0, 2) == 0);
+        rtos_test::checkpoint(7);
+        rtos_test::pass();
+    });
+
+    rtos_test::TaskWithStack task_any(1, false, []{
+        rtos_test::checkpoint(2);
+        const uint32_t flags = events->wait(0x5);
+        rtos_test::checkpoint(6);
+        EXPECT(flags == 0x3);
+    });
+
+    rtos_test::TaskWithStack setter(0, true, []{
+        rtos_test::checkpoint(3);
+        events->set(0x2);  // Satisfies neither waiter
+        rtos_test::checkpoint(4);
+        rtos_test::trigger_timer();  // Wakes both in one pass
+        rtos::task::sleep(10);
+        rtos_test::fail("Should not be reached");
+    });
+
+    rtos::start();
+}
@@ -0,0 +1,55 @@
+#include "rtos_test.hh"
+
+#include <optional>
+
+namespace {
+
+std::optional<rtos_test::TaskWithStack<>> task0;
+volatile bool interrupted_task_seen = false;
+
+} // namespace
+
+int main() {
+    rtos_test::setup();
+
+    rtos_test::set_timer_callback([]{
+        // In an interrupt, the current task is the one that was interrupted.
+        EXPECT(rtos::task::self() == &task0.value());
+        interrupted_task_seen = true;
+    });
+
+    task0.emplace(0, false, []{
+        rtos_test::checkpoint(1);
+        EXPECT(rtos::task::self() == &task0.value());
+
+        const rtos_kernel_info_t before = rtos::kernel_info();
+        EXPECT(before.curr_task == &task0.value());
+        const rtos::Task::Counters counters_before =
+            rtos::task::counters(&task0.value());
+        EXPECT(counters_before.activations == 1);
+
+        // Sleeping switches to the idle task and back.
+        rtos::task::sleep(5);
+        const rtos_kernel_info_t after = rtos::kernel_info();
+        EXPECT(after.tick_count - before.tick_count >= 5);
+        EXPECT(after.tick_count - before.tick_count <= 6);
+        EXPECT(after.epoch - before.epoch == 2);
+        EXPECT(rtos::task::counters(&task0.value()).activations == 2);
+
+        // The time and the task's run time both follow SysTick while it runs.
+        const uint64_t start_time = rtos::time_now();
+        const uint32_t start_systick = rtos_test::systick_count();
+        while (rtos_test::systick_count() - start_systick < 10) {}
+        const uint64_t elapsed = rtos::time_now() - start_time;
+        EXPECT(elapsed >= 9 && elapsed <= 11);
+        EXPECT(rtos::task::counters(&task0.value()).run_ticks -
+               counters_before.run_ticks >= 9);
+
+        rtos_test::start_timer();
+        while (!interrupted_task_seen) {}
+        rtos_test::checkpoint(2);
+        rtos_test::pass();
+    });
+
+    rtos::start();
+}
@@ -0,0 +1,70 @@
+#include "rtos.hh"
+#include "rtos_test.hh"
+
+#include <array>
+#include <optional>
+
+namespace {
+
+std::optional<rtos::Mqueue<int, 8>> mqueue;
+std::optional<rtos_test::TaskWithStack<>> consumer;
+volatile bool batch_sent = false;
+
+} // namespace
+
+int main() {
+    rtos_test::setup();
+
+    mqueue.emplace();
+
+    consumer.emplace(1, false, []{
+        rtos_test::checkpoint(1);
+        std::array<int, 8> buf{};
+
+        // Single enqueues are gathered into the batch and wake it only once
+        const size_t activations =
+            rtos::task::counters(&consumer.value()).activations;
+        EXPECT(mqueue->dequeue_n(buf, 4) == 4);
+        rtos_test::checkpoint(3);
+        EXPECT(rtos::task::counters(&consumer.value()).activations ==
+               activations + 1);
+        for (int i = 0; i < 4; ++i) {
+            EXPECT(buf[i] == i);
+        }
+
+        // The producer fills the queue and blocks for the rest of its batch,
+        // which it moves in as the slots are freed.
+        rtos::task::sleep(5);
+        EXPECT(mqueue->dequeue_n(buf, 0) == 8);
+        for (int i = 0; i < 8; ++i) {
+            EXPECT(buf[i] == 4 + i);
+        }
+        EXPECT(mqueue->dequeue_n(buf, 0) == 4);
+        for (int i = 0; i < 4; ++i) {
+            EXPECT(buf[i] == 12 + i);
+        }
+        EXPECT(mqueue->dequeue_n(buf, 0) == 0);
+
+        rtos::task::sleep(5);
+        rtos_test::checkpoint(5);
+        EXPECT(batch_sent);
+        rtos_test::pass();
+    });
+
+    rtos_test::TaskWithStack producer(0, false, []{
+        rtos_test::checkpoint(2);
+        for (int i = 0; i < 4; ++i) {
+            mqueue->enqueue(i);
+        }
+        std::array<int, 12> batch;
+        for (int i = 0; i < 12; ++i) {
+            batch[i] = 4 + i;
+        }
+        EXPECT(mqueue->enqueue_n(batch, batch.size()) == batch.size());
+        rtos_test::checkpoint(4);
+        batch_sent = true;
+        while (true) {}
+    });
+
+    rtos::start();
+}
@@ -0,0 +1,74 @@
+#include "rtos.hh"
+#include "rtos_test.hh"
+
+#include <array>
+#include <optional>
+
+// The timed batch calls take their timeout as a fifth argument, which is
+// passed on the caller's stack rather than in a register.
+
+namespace {
+
+std::optional<rtos::Mqueue<int, 4>> mqueue;
+
+inline bool fp_active() {
+    return (__get_CONTROL() & (1U << 2U)) != 0;
+}
+
+} // namespace
+
+int main() {
+    rtos_test::setup();
+
+    mqueue.emplace();
+
+    // Handler mode calls read the timeout from the interrupted stack. A
+    // non-zero timeout would fail the assertion that handlers don't block.
+    rtos_test::set_timer_callback([]{
+        rtos_test::checkpoint(5);
+        const std::array<int, 6> batch{10, 11, 12, 13, 14, 15};
+        EXPECT(mqueue->enqueue_n_timed(batch, batch.size(), 0) == 4);
+        std::array<int, 2> buf{};
+        EXPECT(mqueue->dequeue_n_timed(buf, buf.size(), 0) == 2);
+        EXPECT(buf[0] == 10 && buf[1] == 11);
+    });
+
+    rtos_test::TaskWithStack consumer(1, true, []{
+        rtos_test::checkpoint(1);
+
+        // Using the FPU makes the exception frame the extended one, which
+        // moves the stacked arguments further up.
+        volatile float val = 1.5F;
+        val = val * 2.0F;
+        EXPECT(fp_active());
+
+        // Only the producer's first two messages arrive before the timeout
+        std::array<int, 4> buf{};
+        EXPECT(mqueue->dequeue_n_timed(buf, buf.size(), 10) == 2);
+        rtos_test::checkpoint(4);
+        EXPECT(fp_active());
+        EXPECT(buf[0] == 0 && buf[1] == 1);
+
+        rtos_test::trigger_timer();
+        rtos_test::checkpoint(6);
+        EXPECT(mqueue->dequeue_n_timed(buf, buf.size(), 0) == 2);
+        EXPECT(buf[0] == 12 && buf[1] == 13);
+
+        // Nothing is dequeuing, so the full queue makes the last batch time out
+        const std::array<int, 4> fill{20, 21, 22, 23};
+        EXPECT(mqueue->enqueue_n_timed(fill, fill.size(), 0) == 4);
+        EXPECT(mqueue->enqueue_n_timed(fill, 1, 3) == 0);
+        rtos_test::checkpoint(7);
+        rtos_test::pass();
+    });
+
+    rtos_test::TaskWithStack producer(0, false, []{
+        rtos_test::checkpoint(2);
+        const std::array<int, 2> batch{0, 1};
+        EXPECT(mqueue->enqueue_n_timed(batch, batch.size(), 0) == 2);
+        rtos_test::checkpoint(3);
+        while (true) {}
+    });
+
+    rtos::start();
+}
@@ -0,0 +1,46 @@
+#include "rtos.hh"
+#include "rtos_test.hh"
+
+#include <optional>
+
+namespace {
+
+std::optional<rtos::Mqueue<int, 1>> mqueue;
+
+} // namespace
+
+int main() {
+    rtos_test::setup();
+
+    mqueue.emplace();
+
+    rtos_test::TaskWithStack task0(0, false, []{
+        rtos_test::checkpoint(2);
+        rtos::task::sleep(10);
+        rtos_test::checkpoint(4);
+        EXPECT(mqueue->dequeue() == 0);
+        rtos_test::checkpoint(6);
+        EXPECT(mqueue->dequeue() == 2);
+        rtos_test::checkpoint(8);
+        EXPECT(mqueue->dequeue() == 1);
+        rtos_test::checkpoint(9);
+        rtos_test::pass();
+    });
+
+    rtos_test::TaskWithStack task1(1, false, []{
+        rtos_test::checkpoint(1);
+        mqueue->enqueue(0);
+        mqueue->enqueue(1);
+        rtos_test::checkpoint(7);
+    });
+
+    rtos_test::TaskWithStack task2(2, false, []{
+        rtos::task::sleep(5);
+        rtos_test::checkpoint(3);
+        // Started waiting after task1 but gets the free slot first
+        mqueue->enqueue(2);
+        rtos_test::checkpoint(5);
+    });
+
+    rtos::start();
+}
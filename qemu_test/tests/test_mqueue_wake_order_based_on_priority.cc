@@ -0,0 +1,43 @@
+#include "rtos.hh"
+#include "rtos_test.hh"
+
+#include <optional>
+
+namespace {
+
+std::optional<rtos::Mqueue<int, 1>> mqueue;
+
+} // namespace
+
+int main() {
+    rtos_test::setup();
+
+    mqueue.emplace();
+
+    rtos_test::TaskWithStack task0(0, false, []{
+        rtos_test::checkpoint(2);
+        rtos::task::sleep(10);
+        rtos_test::checkpoint(4);
+        mqueue->enqueue(1);
+        rtos_test::checkpoint(6);
+        mqueue->enqueue(2);
+        rtos_test::fail("Should not be reached");
+    });
+
+    rtos_test::TaskWithStack task1(1, false, []{
+        rtos_test::checkpoint(1);
+        EXPECT(mqueue->dequeue() == 2);
+        rtos_test::checkpoint(7);
+        rtos_test::pass();
+    });
+
+    rtos_test::TaskWithStack task2(2, false, []{
+        rtos::task::sleep(5);
+        rtos_test::checkpoint(3);
+        // Started waiting after task1 but is woken first
+        EXPECT(mqueue->dequeue() == 1);
+        rtos_test::checkpoint(5);
+    });
+
+    rtos::start();
+}
@@ -0,0 +1,79 @@
+#include "rtos.hh"
+#include "rtos_test.hh"
+
+#include <cstdint>
+#include <optional>
+
+namespace {
+
+struct Frame {
+    uint32_t seq;
+    uint8_t payload[60];
+};
+
+std::optional<rtos::Mqueue<Frame, 2>> mqueue;
+
+void fill(Frame *frame, uint32_t seq) {
+    frame->seq = seq;
+    for (auto &byte : frame->payload) {
+        byte = static_cast<uint8_t>(seq);
+    }
+}
+
+bool in_storage(const Frame *frame) {
+    const auto *const ptr = reinterpret_cast<const uint8_t *>(frame);
+    return ptr >= mqueue->storage.data() &&
+           ptr < mqueue->storage.data() + mqueue->storage.size();
+}
+
+} // namespace
+
+int main() {
+    rtos_test::setup();
+
+    mqueue.emplace();
+
+    rtos_test::TaskWithStack consumer(1, false, []{
+        rtos_test::checkpoint(1);
+        // Blocks until the producer commits its first frame
+        Frame *frame = mqueue->acquire();
+        rtos_test::checkpoint(3);
+        EXPECT(in_storage(frame));
+        EXPECT(frame->seq == 1);
+        EXPECT(frame->payload[59] == 1);
+        mqueue->release();
+
+        // Let the producer fill the queue and block on its next reservation
+        rtos::task::sleep(5);
+        rtos_test::checkpoint(5);
+        frame = mqueue->acquire();
+        EXPECT(frame->seq == 2);
+        mqueue->release();  // Hands the freed slot to the producer
+        EXPECT(mqueue->dequeue().seq == 3);
+        EXPECT(mqueue->dequeue().seq == 4);
+        rtos_test::checkpoint(7);
+        rtos_test::pass();
+    });
+
+    rtos_test::TaskWithStack producer(0, false, []{
+        rtos_test::checkpoint(2);
+        Frame *frame = mqueue->reserve();
+        EXPECT(in_storage(frame));
+        fill(frame, 1);
+        mqueue->commit();
+
+        rtos_test::checkpoint(4);
+        fill(mqueue->reserve(), 2);
+        mqueue->commit();
+        Frame copied;
+        fill(&copied, 3);
+        mqueue->enqueue(copied);
+        frame = mqueue->reserve();  // Blocks while the queue is full
+        rtos_test::checkpoint(6);
+        fill(frame, 4);
+        mqueue->commit();
+        while (true) {}
+    });
+
+    rtos::start();
+}
@@ -0,0 +1,30 @@
+#include "rtos_test.hh"
+
+namespace {
+
+constexpr uint32_t iterations = 1000;
+
+} // namespace
+
+int main() {
+    rtos_test::setup();
+
+    rtos_test::TaskWithStack task(0, true, []{
+        rtos::Mutex mutex;
+
+        const uint32_t start = rtos_test::cycle_count();
+        for (uint32_t i = 0; i < iterations; ++i) {
+            mutex.lock();
+            mutex.unlock();
+        }
+        const uint32_t cycles = rtos_test::cycle_count() - start;
+
+        rtos_test::report_bench(RTOS_ENABLE_MUTEX_FAST_PATH
+                                    ? "Mutex lock/unlock cycles (fast path)"
+                                    : "Mutex lock/unlock cycles (syscall)",
+                                cycles / iterations);
+        rtos_test::pass();
+    });
+
+    rtos::start();
+}
@@ -0,0 +1,39 @@
+#include "rtos_test.hh"
+
+#include <optional>
+
+namespace {
+
+std::optional<rtos::Mutex> mutex;
+
+} // namespace
+
+int main() {
+    rtos_test::setup();
+
+    rtos_test::TaskWithStack task_mid(1, false, []{
+        rtos_test::checkpoint(1);
+        rtos::task::sleep(2);
+
+        // Only reached once the low priority task unlocks the mutex.
+        rtos_test::checkpoint(4);
+        rtos_test::pass();
+    });
+
+    rtos_test::TaskWithStack task_low(0, false, []{
+        rtos_test::checkpoint(2);
+        mutex.emplace(2);
+
+        // An uncontended lock doesn't enter the kernel but the task still has
+        // to run at the ceiling, so waking the other task doesn't preempt it.
+        mutex->lock();
+        const uint32_t start = rtos_test::systick_count();
+        while (rtos_test::systick_count() - start < 5) {}
+        rtos_test::checkpoint(3);
+        mutex->unlock();
+
+        rtos_test::fail("Unlocking should have been preempted");
+    });
+
+    rtos::start();
+}
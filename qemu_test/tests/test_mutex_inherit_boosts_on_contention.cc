@@ -0,0 +1,56 @@
+#include "rtos.hh"
+#include "rtos_test.hh"
+
+#include <optional>
+
+namespace {
+
+std::optional<rtos::Mutex> mutex;
+
+void spin(uint32_t systicks) {
+    const uint32_t start = rtos_test::systick_count();
+    while (rtos_test::systick_count() - start < systicks) {}
+}
+
+} // namespace
+
+int main() {
+    rtos_test::setup();
+
+    mutex.emplace(rtos::PriorityInheritance{});
+
+    rtos_test::TaskWithStack task_high(2, false, []{
+        rtos::task::sleep(10);
+        rtos_test::checkpoint(5);
+        mutex->lock();
+        rtos_test::checkpoint(7);
+        mutex->unlock();
+        rtos_test::pass();
+    });
+
+    rtos_test::TaskWithStack task_mid(1, false, []{
+        rtos_test::checkpoint(1);
+        rtos::task::sleep(2);
+
+        // Preempts the low priority task since nothing is waiting on the mutex
+        rtos_test::checkpoint(3);
+        rtos::task::sleep(10);
+        rtos_test::fail("The low priority task should have been boosted");
+    });
+
+    rtos_test::TaskWithStack task_low(0, false, []{
+        rtos_test::checkpoint(2);
+        mutex->lock();
+        spin(5);
+        rtos_test::checkpoint(4);
+
+        // Raised to the high priority task's priority once it blocks, so the
+        // mid priority task doesn't run when it wakes
+        spin(10);
+        rtos_test::checkpoint(6);
+        mutex->unlock();
+        rtos_test::fail("Unlocking should have been preempted");
+    });
+
+    rtos::start();
+}
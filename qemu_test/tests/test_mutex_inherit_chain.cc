@@ -0,0 +1,65 @@
+#include "rtos.hh"
+#include "rtos_test.hh"
+
+#include <optional>
+
+namespace {
+
+std::optional<rtos::Mutex> outer;
+std::optional<rtos::Mutex> inner;
+
+void spin(uint32_t systicks) {
+    const uint32_t start = rtos_test::systick_count();
+    while (rtos_test::systick_count() - start < systicks) {}
+}
+
+} // namespace
+
+int main() {
+    rtos_test::setup();
+
+    outer.emplace(rtos::PriorityInheritance{});
+    inner.emplace(rtos::PriorityInheritance{});
+
+    rtos_test::TaskWithStack task_high(2, false, []{
+        rtos::task::sleep(4);
+        rtos_test::checkpoint(4);
+        outer->lock();
+        rtos_test::checkpoint(7);
+        EXPECT(rtos::task::self()->priority == 2);
+        outer->unlock();
+        rtos_test::pass();
+    });
+
+    rtos_test::TaskWithStack task_mid(1, false, []{
+        rtos::task::sleep(2);
+        rtos_test::checkpoint(3);
+        outer->lock();
+        inner->lock();
+        rtos_test::checkpoint(6);
+        EXPECT(rtos::task::self()->priority == 2);
+        inner->unlock();
+
+        // Still inherits from the high priority task through the outer mutex
+        EXPECT(rtos::task::self()->priority == 2);
+        outer->unlock();
+        rtos_test::fail("Unlocking should have been preempted");
+    });
+
+    rtos_test::TaskWithStack task_low(0, false, []{
+        rtos_test::checkpoint(1);
+        inner->lock();
+        EXPECT(rtos::task::self()->priority == 0);
+        rtos_test::checkpoint(2);
+
+        // The high priority task blocks on the outer mutex held by the mid
+        // priority task, which is blocked on the inner mutex
+        spin(6);
+        rtos_test::checkpoint(5);
+        EXPECT(rtos::task::self()->priority == 2);
+        inner->unlock();
+        rtos_test::fail("Unlocking should have been preempted");
+    });
+
+    rtos::start();
+}
@@ -0,0 +1,56 @@
+#include "rtos.hh"
+#include "rtos_test.hh"
+
+#include <optional>
+
+namespace {
+
+std::optional<rtos::Mutex> mutex;
+std::optional<rtos::Mqueue<int, 1>> mqueue;
+
+} // namespace
+
+int main() {
+    rtos_test::setup();
+
+    mutex.emplace(rtos::PriorityInheritance{});
+    mqueue.emplace();
+
+    rtos_test::TaskWithStack task_high(2, false, []{
+        rtos::task::sleep(4);
+        rtos_test::checkpoint(3);
+        mutex->lock();
+        rtos_test::checkpoint(6);
+        mutex->unlock();
+        rtos_test::pass();
+    });
+
+    rtos_test::TaskWithStack task_mid(1, false, []{
+        rtos::task::sleep(2);
+        rtos_test::checkpoint(2);
+        mqueue->dequeue();
+        rtos_test::fail("Should have been woken after the boosted owner");
+    });
+
+    rtos_test::TaskWithStack task_low(0, false, []{
+        rtos_test::checkpoint(1);
+        mutex->lock();
+
+        // Started waiting before the mid priority task but is moved ahead of
+        // it when the high priority task blocks on the mutex
+        EXPECT(mqueue->dequeue() == 1);
+        rtos_test::checkpoint(5);
+        EXPECT(rtos::task::self()->priority == 2);
+        mutex->unlock();
+        rtos_test::fail("Unlocking should have been preempted");
+    });
+
+    rtos_test::TaskWithStack producer(0, false, []{
+        rtos::task::sleep(10);
+        rtos_test::checkpoint(4);
+        mqueue->enqueue(1);
+        rtos_test::fail("Should not be reached");
+    });
+
+    rtos::start();
+}
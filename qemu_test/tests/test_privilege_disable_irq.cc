@@ -1,17 +1,35 @@
 #include "rtos_test.hh"
 
+namespace {
+
+volatile int timer_count = 0;
+
+} // namespace
+
 int main() {
     rtos_test::setup();
 
+    rtos_test::set_timer_callback([]{
+        timer_count = timer_count + 1;
+    });
+
     rtos_test::TaskWithStack privileged(1, true, []{
         rtos_test::checkpoint(1);
         __disable_irq();
+        rtos_test::trigger_timer();
+        const int timer_count_while_disabled = timer_count;
         __enable_irq();
+        EXPECT(timer_count_while_disabled == 0);
+        EXPECT(timer_count == 1);
     });
 
+    // CPSID is ignored in unprivileged mode rather than faulting. The system
+    // call after it would escalate to a HardFault if it had masked interrupts.
     rtos_test::TaskWithStack unprivileged(0, false, []{
         rtos_test::checkpoint(2);
-        rtos_test::expect_hardfault_to_pass([]{ __disable_irq(); });
+        __disable_irq();
+        rtos_test::checkpoint(3);
+        rtos_test::pass();
     });
 
     rtos::start();
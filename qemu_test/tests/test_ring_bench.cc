@@ -0,0 +1,85 @@
+#include "rtos_test.hh"
+
+#include <optional>
+
+namespace {
+
+// Each timer interrupt writes a burst of samples like a DMA half-transfer
+// interrupt would.
+constexpr uint32_t burst_size = 32;
+
+std::optional<rtos::Ring<uint32_t, burst_size>> ring;
+std::optional<rtos::Mqueue<uint32_t, burst_size>> mqueue;
+std::optional<rtos_test::TaskWithStack<>> consumer;
+
+} // namespace
+
+int main() {
+    rtos_test::setup();
+
+    ring.emplace();
+    mqueue.emplace();
+
+    // The bursts are timed inside the TIM2 handler, which SysTick can't
+    // preempt, so this relies on cycle_count() using the DWT cycle counter.
+    rtos_test::set_timer_callback([]{
+        static int count = 0;
+        if (count == 0) {
+            const uint32_t start = rtos_test::cycle_count();
+            for (uint32_t i = 0; i < burst_size; ++i) {
+                EXPECT(ring->try_write(i));
+            }
+            const uint32_t cycles = rtos_test::cycle_count() - start;
+            EXPECT(!ring->try_write(burst_size));
+            rtos_test::report_bench("Ring write cycles per sample",
+                                    cycles / burst_size);
+        } else if (count == 1) {
+            const uint32_t start = rtos_test::cycle_count();
+            for (uint32_t i = 0; i < burst_size; ++i) {
+                EXPECT(mqueue->try_enqueue_isr(i));
+            }
+            const uint32_t cycles = rtos_test::cycle_count() - start;
+            rtos_test::report_bench(
+                "Mqueue try_enqueue_isr cycles per sample",
+                cycles / burst_size);
+        }
+        ++count;
+    });
+
+    consumer.emplace(1, true, []{
+        rtos_test::checkpoint(1);
+        const size_t activations =
+            rtos::task::counters(&consumer.value()).activations;
+
+        // Blocks until the first burst is written.
+        EXPECT(ring->read() == 0);
+
+        const uint32_t start = rtos_test::cycle_count();
+        for (uint32_t i = 1; i < burst_size; ++i) {
+            EXPECT(ring->read() == i);
+        }
+        const uint32_t cycles = rtos_test::cycle_count() - start;
+        rtos_test::report_bench("Ring read cycles per sample",
+                                cycles / (burst_size - 1));
+
+        // The whole burst was read after a single wake up.
+        EXPECT(rtos::task::counters(&consumer.value()).activations ==
+               activations + 1);
+        uint32_t data;
+        EXPECT(!ring->try_read(data));
+
+        for (uint32_t i = 0; i < burst_size; ++i) {
+            EXPECT(mqueue->dequeue() == i);
+        }
+        rtos_test::checkpoint(3);
+        rtos_test::pass();
+    });
+
+    rtos_test::TaskWithStack producer(0, false, []{
+        rtos_test::checkpoint(2);
+        rtos_test::start_timer();
+        while (true) {}
+    });
+
+    rtos::start();
+}
@@ -0,0 +1,52 @@
+#include "rtos.hh"
+#include "rtos_test.hh"
+
+#include <optional>
+
+namespace {
+
+std::optional<rtos::RwLock> rwlock;
+
+void spin(uint32_t systicks) {
+    const uint32_t start = rtos_test::systick_count();
+    while (rtos_test::systick_count() - start < systicks) {}
+}
+
+} // namespace
+
+int main() {
+    rtos_test::setup();
+
+    rwlock.emplace(2);
+
+    rtos_test::TaskWithStack task_mid(1, false, []{
+        rtos_test::checkpoint(1);
+        rtos::task::sleep(2);
+
+        // Only reached once the low priority task read unlocks
+        rtos_test::checkpoint(4);
+        rtos::task::sleep(2);
+
+        // Only reached once the low priority task write unlocks
+        rtos_test::checkpoint(7);
+        rtos_test::pass();
+    });
+
+    rtos_test::TaskWithStack task_low(0, false, []{
+        rtos_test::checkpoint(2);
+        rwlock->read_lock();
+        spin(5);
+        rtos_test::checkpoint(3);
+        rwlock->read_unlock();
+
+        rtos_test::checkpoint(5);
+        rwlock->write_lock();
+        spin(5);
+        rtos_test::checkpoint(6);
+        rwlock->write_unlock();
+
+        rtos_test::fail("Unlocking should have been preempted");
+    });
+
+    rtos::start();
+}
@@ -0,0 +1,38 @@
+#include "rtos.hh"
+#include "rtos_test.hh"
+
+#include <optional>
+
+namespace {
+
+std::optional<rtos::RwLock> rwlock;
+
+} // namespace
+
+int main() {
+    rtos_test::setup();
+
+    rwlock.emplace();
+
+    rtos_test::TaskWithStack task1(1, false, []{
+        rtos_test::checkpoint(1);
+        rwlock->read_lock();
+        rtos::task::sleep(5);
+        rtos_test::checkpoint(5);
+        rwlock->read_unlock();
+        rtos_test::pass();
+    });
+
+    rtos_test::TaskWithStack task0(0, false, []{
+        rtos_test::checkpoint(2);
+        // Doesn't block while the other reader holds the lock
+        rwlock->read_lock();
+        rtos_test::checkpoint(3);
+        rwlock->read_unlock();
+        rtos_test::checkpoint(4);
+        rtos::task::sleep(100);
+        rtos_test::fail("Should not be reached");
+    });
+
+    rtos::start();
+}
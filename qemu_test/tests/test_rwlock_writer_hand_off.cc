@@ -0,0 +1,46 @@
+#include "rtos.hh"
+#include "rtos_test.hh"
+
+#include <optional>
+
+namespace {
+
+std::optional<rtos::RwLock> rwlock;
+
+} // namespace
+
+int main() {
+    rtos_test::setup();
+
+    rwlock.emplace();
+
+    rtos_test::TaskWithStack reader0(1, false, []{
+        rtos_test::checkpoint(1);
+        rwlock->read_lock();
+        rtos::task::sleep(10);
+        rtos_test::checkpoint(4);
+        // Hands the lock to the waiting writer, which runs at the ceiling
+        rwlock->read_unlock();
+        rtos_test::checkpoint(7);
+        rtos_test::pass();
+    });
+
+    rtos_test::TaskWithStack writer(0, false, []{
+        rtos_test::checkpoint(2);
+        rwlock->write_lock();
+        rtos_test::checkpoint(5);
+        rwlock->write_unlock();
+        rtos_test::fail("Should be preempted by the waiting reader");
+    });
+
+    rtos_test::TaskWithStack reader1(0, false, []{
+        rtos_test::checkpoint(3);
+        // Waits behind the writer even though only a reader holds the lock
+        rwlock->read_lock();
+        rtos_test::checkpoint(6);
+        rwlock->read_unlock();
+        rtos_test::fail("Should be preempted by the first reader");
+    });
+
+    rtos::start();
+}
@@ -0,0 +1,67 @@
+#include "rtos.hh"
+#include "rtos_test.hh"
+
+#include <cstddef>
+#include <cstdint>
+
+namespace {
+
+constexpr size_t short_slice = 5;
+constexpr size_t long_slice = 20;
+
+volatile bool peer_ran = false;
+volatile int running = -1;
+volatile uint32_t slice_start = 0;
+volatile int switches = 0;
+
+// Each time a task is switched in, it checks how long the other task ran for.
+template<int id, size_t other_slice>
+void round_robin_task() {
+    while (true) {
+        if (running != id) {
+            const uint32_t now = HAL_GetTick();
+            if (running != -1) {
+                const uint32_t length = now - slice_start;
+                EXPECT(length + 1 >= other_slice && length <= other_slice + 1);
+                switches = switches + 1;
+                if (switches == 6) {
+                    rtos_test::pass();
+                }
+            }
+            slice_start = now;
+            running = id;
+        }
+    }
+}
+
+} // namespace
+
+int main() {
+    rtos_test::setup();
+
+    // The FIFO task keeps running past several default time slices even
+    // though another task at the same priority is ready.
+    rtos_test::TaskWithStack fifo({
+        .priority = 2,
+        .policy = RTOS_SCHED_FIFO,
+    }, []{
+        HAL_Delay(3 * rtos::ticks_per_slice);
+        EXPECT(!peer_ran);
+    });
+
+    rtos_test::TaskWithStack peer(2, false, []{
+        peer_ran = true;
+    });
+
+    // Round-robin tasks at the same priority with different time slices
+    rtos_test::TaskWithStack short_task({
+        .priority = 1,
+        .time_slice = short_slice,
+    }, round_robin_task<0, long_slice>);
+    rtos_test::TaskWithStack long_task({
+        .priority = 1,
+        .time_slice = long_slice,
+    }, round_robin_task<1, short_slice>);
+
+    rtos::start();
+}
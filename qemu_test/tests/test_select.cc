@@ -0,0 +1,81 @@
+#include "rtos.hh"
+#include "rtos_test.hh"
+
+#include <array>
+#include <optional>
+
+namespace {
+
+std::optional<rtos::Mqueue<int, 4>> first;
+std::optional<rtos::Mqueue<int, 4>> second;
+std::optional<rtos::Semaphore> sem;
+std::optional<rtos::EventGroup> events;
+std::array<rtos_select_member_t, 4> members;
+std::optional<rtos::Select> select;
+
+} // namespace
+
+int main() {
+    rtos_test::setup();
+
+    first.emplace();
+    second.emplace();
+    sem.emplace(0, 1);
+    events.emplace();
+    members = {{
+        {RTOS_SELECT_MQUEUE, &first->mqueue, 0},
+        {RTOS_SELECT_MQUEUE, &second->mqueue, 0},
+        {RTOS_SELECT_SEM, &sem->sem, 0},
+        {RTOS_SELECT_EVENT_GROUP, &events->group, 0x2},
+    }};
+    select.emplace(members);
+
+    rtos_test::set_timer_callback([]{
+        EXPECT(sem->give_isr());
+    });
+
+    rtos_test::TaskWithStack gateway(2, false, []{
+        rtos_test::checkpoint(1);
+        EXPECT(select->wait_timed(0) == RTOS_SELECT_TIMED_OUT);
+        EXPECT(select->wait_timed(2) == RTOS_SELECT_TIMED_OUT);
+
+        EXPECT(select->wait() == 1);
+        int data = 0;
+        EXPECT(second->dequeue_timed(data, 0));
+        EXPECT(data == 7);
+        rtos_test::checkpoint(3);
+
+        // Woken by the semaphore but not by the flag it isn't waiting for
+        EXPECT(select->wait() == 2);
+        EXPECT(sem->take_timed(0));
+        rtos_test::checkpoint(6);
+
+        EXPECT(select->wait() == 3);
+        events->clear(0x3);
+        rtos_test::checkpoint(8);
+
+        // Already ready members don't block
+        EXPECT(first->enqueue_timed(5, 0));
+        EXPECT(select->wait() == 0);
+        EXPECT(first->dequeue_timed(data, 0));
+        EXPECT(data == 5);
+        EXPECT(select->wait_timed(0) == RTOS_SELECT_TIMED_OUT);
+        rtos_test::checkpoint(9);
+        rtos_test::pass();
+    });
+
+    rtos_test::TaskWithStack producer(1, true, []{
+        rtos_test::checkpoint(2);
+        second->enqueue(7);
+        rtos_test::checkpoint(4);
+        events->set(0x1);
+        rtos_test::checkpoint(5);
+        rtos_test::trigger_timer();
+        rtos_test::checkpoint(7);
+        events->set(0x2);
+        rtos::task::sleep(100);
+        rtos_test::fail("Should not be reached");
+    });
+
+    rtos::start();
+}
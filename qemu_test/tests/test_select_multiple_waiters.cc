@@ -0,0 +1,55 @@
+#include "rtos.hh"
+#include "rtos_test.hh"
+
+#include <array>
+#include <optional>
+
+namespace {
+
+std::optional<rtos::Mqueue<int, 1>> mqueue;
+std::optional<rtos::Semaphore> sem;
+std::array<rtos_select_member_t, 2> members;
+std::optional<rtos::Select> select;
+
+} // namespace
+
+int main() {
+    rtos_test::setup();
+
+    mqueue.emplace();
+    sem.emplace(0, 1);
+    members = {{
+        {RTOS_SELECT_MQUEUE, &mqueue->mqueue, 0},
+        {RTOS_SELECT_SEM, &sem->sem, 0},
+    }};
+    select.emplace(members);
+
+    rtos_test::TaskWithStack waiter_high(2, false, []{
+        rtos_test::checkpoint(1);
+        EXPECT(select->wait() == 0);
+        int data = 0;
+        EXPECT(mqueue->dequeue_timed(data, 0));
+        EXPECT(data == 1);
+        rtos_test::checkpoint(4);
+    });
+
+    rtos_test::TaskWithStack waiter_mid(1, false, []{
+        rtos_test::checkpoint(2);
+        // Also woken by the message but the high priority task takes it, so
+        // this task keeps waiting until the semaphore is given
+        EXPECT(select->wait() == 1);
+        EXPECT(sem->take_timed(0));
+        rtos_test::checkpoint(6);
+        rtos_test::pass();
+    });
+
+    rtos_test::TaskWithStack producer(0, false, []{
+        rtos_test::checkpoint(3);
+        mqueue->enqueue(1);
+        rtos_test::checkpoint(5);
+        EXPECT(sem->give());
+        rtos_test::fail("Should not be reached");
+    });
+
+    rtos::start();
+}
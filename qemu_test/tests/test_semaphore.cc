@@ -0,0 +1,58 @@
+#include "rtos.hh"
+#include "rtos_test.hh"
+
+#include <optional>
+
+namespace {
+
+std::optional<rtos::Semaphore> sem;
+
+} // namespace
+
+int main() {
+    rtos_test::setup();
+
+    sem.emplace(0, 3);
+
+    rtos_test::set_timer_callback([]{
+        EXPECT(sem->give_isr());
+    });
+
+    rtos_test::TaskWithStack high(2, false, []{
+        rtos_test::checkpoint(1);
+        rtos::task::sleep(2);
+        rtos_test::checkpoint(3);
+        sem->take();
+        // Woken before the task that started waiting earlier
+        rtos_test::checkpoint(5);
+    });
+
+    rtos_test::TaskWithStack low(1, false, []{
+        rtos_test::checkpoint(2);
+        sem->take();
+        rtos_test::checkpoint(6);
+
+        for (int i = 0; i < 3; ++i) {
+            EXPECT(sem->give());
+        }
+        EXPECT(!sem->give());
+        for (int i = 0; i < 3; ++i) {
+            EXPECT(sem->take_timed(0));
+        }
+        EXPECT(!sem->take_timed(0));
+        EXPECT(!sem->take_timed(2));
+        rtos_test::checkpoint(7);
+        rtos_test::pass();
+    });
+
+    rtos_test::TaskWithStack giver(0, true, []{
+        rtos::task::sleep(5);
+        rtos_test::checkpoint(4);
+        EXPECT(sem->give());
+        rtos_test::trigger_timer();
+        rtos::task::sleep(100);
+        rtos_test::fail("Should not be reached");
+    });
+
+    rtos::start();
+}
@@ -0,0 +1,109 @@
+#include "rtos.hh"
+#include "rtos_test.hh"
+
+#include <array>
+#include <cstdint>
+#include <optional>
+
+namespace {
+
+std::optional<rtos::Stream<32>> stream;
+std::optional<rtos::MessageBuffer<32>> msgbuf;
+std::optional<rtos_test::TaskWithStack<>> receiver;
+volatile bool isr_sent = false;
+volatile bool messages_sent = false;
+
+bool filled_with(std::span<const uint8_t> data, uint8_t value) {
+    for (const uint8_t byte : data) {
+        if (byte != value) {
+            return false;
+        }
+    }
+    return true;
+}
+
+} // namespace
+
+int main() {
+    rtos_test::setup();
+
+    stream.emplace(8);
+    msgbuf.emplace();
+
+    rtos_test::set_timer_callback([]{
+        const std::array<uint8_t, 3> data{9, 10, 11};
+        EXPECT(stream->send_isr(data) == data.size());
+        isr_sent = true;
+    });
+
+    receiver.emplace(1, true, []{
+        rtos_test::checkpoint(1);
+        std::array<uint8_t, 24> buf{};
+
+        // Only woken once the trigger level is reached
+        const size_t activations =
+            rtos::task::counters(&receiver.value()).activations;
+        EXPECT(stream->receive(buf) == 9);
+        rtos_test::checkpoint(4);
+        EXPECT(rtos::task::counters(&receiver.value()).activations ==
+               activations + 1);
+        for (uint8_t i = 0; i < 9; ++i) {
+            EXPECT(buf[i] == i);
+        }
+
+        // Below the trigger level, so only available without blocking
+        rtos_test::trigger_timer();
+        while (!isr_sent) {}
+        EXPECT(stream->receive_isr(buf) == 3);
+        EXPECT(buf[0] == 9 && buf[1] == 10 && buf[2] == 11);
+
+        // The sender blocks on its third message until there's room
+        rtos::task::sleep(5);
+        rtos_test::checkpoint(6);
+        std::array<uint8_t, 2> small{};
+        EXPECT(msgbuf->receive(small) == 0);
+        EXPECT(msgbuf->receive(buf) == 5);
+        EXPECT(filled_with(std::span(buf).first(5), 1));
+        EXPECT(msgbuf->receive(buf) == 1);
+        EXPECT(buf[0] == 2);
+        EXPECT(msgbuf->receive(buf) == 20);
+        EXPECT(filled_with(std::span(buf).first(20), 3));
+        EXPECT(msgbuf->receive_isr(buf) == 0);
+
+        rtos::task::sleep(5);
+        rtos_test::checkpoint(8);
+        EXPECT(messages_sent);
+
+        // A message too long for the receiver's buffer can be dropped
+        msgbuf->send(std::array<uint8_t, 4>{4, 4, 4, 4});
+        msgbuf->send(std::array<uint8_t, 1>{5});
+        EXPECT(msgbuf->receive(small) == 0);
+        EXPECT(msgbuf->discard() == 4);
+        EXPECT(msgbuf->receive(small) == 1);
+        EXPECT(small[0] == 5);
+        EXPECT(msgbuf->discard() == 0);
+        rtos_test::pass();
+    });
+
+    rtos_test::TaskWithStack sender(0, false, []{
+        rtos_test::checkpoint(2);
+        stream->send(std::array<uint8_t, 3>{0, 1, 2});
+        stream->send(std::array<uint8_t, 3>{3, 4, 5});
+        rtos_test::checkpoint(3);
+        stream->send(std::array<uint8_t, 3>{6, 7, 8});
+
+        rtos_test::checkpoint(5);
+        std::array<uint8_t, 20> message;
+        message.fill(1);
+        msgbuf->send(std::span(message).first(5));
+        message.fill(2);
+        msgbuf->send(std::span(message).first(1));
+        message.fill(3);
+        msgbuf->send(message);
+        rtos_test::checkpoint(7);
+        messages_sent = true;
+        while (true) {}
+    });
+
+    rtos::start();
+}
@@ -0,0 +1,46 @@
+#include "rtos_test.hh"
+
+namespace {
+
+constexpr uint32_t iterations = 1000;
+
+// A system call that does little work so that the cost of entering and
+// leaving the kernel dominates.
+uint32_t measure_syscall() {
+    rtos::Task *const task = rtos::task::self();
+    rtos::Task::Stats stats;
+    const uint32_t start = rtos_test::cycle_count();
+    for (uint32_t i = 0; i < iterations; ++i) {
+        rtos_task_get_stats(task, &stats);
+    }
+    return (rtos_test::cycle_count() - start) / iterations;
+}
+
+} // namespace
+
+int main() {
+    rtos_test::setup();
+
+    rtos_test::TaskWithStack task(0, true, []{
+        rtos_test::report_bench(RTOS_ENABLE_SYSCALL_TABLE
+                                    ? "Syscall cycles (SVC trap, table)"
+                                    : "Syscall cycles (SVC trap, switch)",
+                                measure_syscall());
+#if RTOS_ENABLE_SYSCALL_TABLE
+        rtos_test::start_timer();
+        while (true) {}
+#else
+        // The original ABI can't be used from handler mode.
+        rtos_test::pass();
+#endif
+    });
+
+    rtos_test::set_timer_callback([]{
+        // Handler mode makes the call directly.
+        rtos_test::report_bench("Syscall cycles (direct call)",
+                                measure_syscall());
+        rtos_test::pass();
+    });
+
+    rtos::start();
+}
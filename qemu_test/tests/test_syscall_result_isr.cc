@@ -0,0 +1,49 @@
+#include "rtos.hh"
+#include "rtos_test.hh"
+
+#include <optional>
+
+namespace {
+
+std::optional<rtos::Semaphore> given;
+std::optional<rtos::Semaphore> empty;
+volatile bool trigger_on_switch = false;
+
+} // namespace
+
+int main() {
+    rtos_test::setup();
+
+    given.emplace(0, 1);
+    empty.emplace(0, 1);
+
+    // Runs between the switch to the woken task and its return from the system
+    // call. The failed take must not change the woken task's result.
+    rtos_test::set_timer_callback([]{
+        rtos_test::checkpoint(3);
+        EXPECT(!empty->take_timed(0));
+    });
+
+    rtos_test::set_context_switch_callback([]{
+        if (trigger_on_switch) {
+            trigger_on_switch = false;
+            rtos_test::trigger_timer();
+        }
+    });
+
+    rtos_test::TaskWithStack taker(1, false, []{
+        rtos_test::checkpoint(1);
+        EXPECT(given->take_timed(100));
+        rtos_test::checkpoint(4);
+        rtos_test::pass();
+    });
+
+    rtos_test::TaskWithStack giver(0, false, []{
+        rtos_test::checkpoint(2);
+        trigger_on_switch = true;
+        given->give();
+        rtos_test::fail("Should not be reached");
+    });
+
+    rtos::start();
+}
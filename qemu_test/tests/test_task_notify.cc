@@ -0,0 +1,78 @@
+#include "rtos.hh"
+#include "rtos_test.hh"
+
+namespace {
+
+rtos::Task *waiter_task;
+volatile bool spoil = false;
+
+} // namespace
+
+int main() {
+    rtos_test::setup();
+
+    rtos_test::set_timer_callback([]{
+        for (int i = 0; i < 3; ++i) {
+            EXPECT(rtos::task::notify_isr(waiter_task, 0,
+                                          RTOS_NOTIFY_INCREMENT));
+        }
+    });
+
+    rtos_test::TaskWithStack waiter(1, false, []{
+        rtos_test::checkpoint(1);
+        EXPECT(rtos::task::notify_wait(true) == 0x5);
+        rtos_test::checkpoint(3);
+
+        // All three increments are seen by a single wakeup
+        EXPECT(rtos::task::notify_wait(false) == 3);
+        rtos_test::checkpoint(5);
+        EXPECT(rtos::task::notify_wait(false) == 2);
+        EXPECT(rtos::task::notify_wait(true) == 1);
+
+        rtos::Task *const self = rtos::task::self();
+        EXPECT(rtos::task::notify(self, 0x1, RTOS_NOTIFY_SET_BITS));
+        EXPECT(rtos::task::notify(self, 0x4, RTOS_NOTIFY_SET_BITS));
+        EXPECT(rtos::task::notify_wait(true) == 0x5);
+
+        EXPECT(rtos::task::notify(self, 7, RTOS_NOTIFY_OVERWRITE_IF_EMPTY));
+        EXPECT(!rtos::task::notify(self, 9, RTOS_NOTIFY_OVERWRITE_IF_EMPTY));
+        EXPECT(rtos::task::notify(self, 4, RTOS_NOTIFY_OVERWRITE));
+        EXPECT(rtos::task::notify_wait_timed(true, 0) == 4);
+        EXPECT(rtos::task::notify_wait_timed(true, 0) == 0);
+        EXPECT(rtos::task::notify_wait_timed(true, 2) == 0);
+        rtos_test::checkpoint(6);
+
+        // Wakeups whose value is overwritten with 0 before this task runs
+        // don't restart the timeout
+        spoil = true;
+        const uint64_t start = rtos::time_now();
+        EXPECT(rtos::task::notify_wait_timed(true, 10) == 0);
+        const uint64_t elapsed = rtos::time_now() - start;
+        EXPECT(elapsed >= 10 && elapsed <= 11);
+        rtos_test::pass();
+    });
+    waiter_task = &waiter;
+
+    rtos_test::TaskWithStack notifier(0, true, []{
+        rtos_test::checkpoint(2);
+        EXPECT(rtos::task::notify(waiter_task, 0x5, RTOS_NOTIFY_SET_BITS));
+        rtos_test::checkpoint(4);
+        rtos_test::trigger_timer();
+        rtos::task::sleep(100);
+        rtos_test::fail("Should not be reached");
+    });
+
+    rtos_test::TaskWithStack spoiler(2, false, []{
+        while (true) {
+            rtos::task::sleep(4);
+            if (spoil) {
+                EXPECT(rtos::task::notify(waiter_task, 1,
+                                          RTOS_NOTIFY_SET_BITS));
+                EXPECT(rtos::task::notify(waiter_task, 0,
+                                          RTOS_NOTIFY_OVERWRITE));
+            }
+        }
+    });
+
+    rtos::start();
+}
@@ -0,0 +1,37 @@
+#include "rtos.hh"
+#include "rtos_test.hh"
+
+#include <cstddef>
+#include <cstdint>
+
+namespace {
+
+// Sleep durations straddle the slot boundaries between the levels of the
+// sleeping task timing wheel.
+template<size_t ticks, int checkpoint_num>
+void sleeper() {
+    const uint32_t time_before_sleep = HAL_GetTick();
+    rtos::task::sleep(ticks);
+    EXPECT(HAL_GetTick() - time_before_sleep >= ticks);
+    rtos_test::checkpoint(checkpoint_num);
+}
+
+} // namespace
+
+int main() {
+    rtos_test::setup();
+
+    rtos_test::TaskWithStack task0(0, false, sleeper<1024, 5>);
+    rtos_test::TaskWithStack task1(0, false, sleeper<32, 2>);
+    rtos_test::TaskWithStack task2(0, false, sleeper<1023, 4>);
+    rtos_test::TaskWithStack task3(0, false, sleeper<31, 1>);
+    rtos_test::TaskWithStack task4(0, false, sleeper<33, 3>);
+
+    rtos_test::TaskWithStack task5(0, false, []{
+        rtos::task::sleep(1025);
+        rtos_test::checkpoint(6);
+        rtos_test::pass();
+    });
+
+    rtos::start();
+}
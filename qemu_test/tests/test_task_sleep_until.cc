@@ -0,0 +1,60 @@
+#include "rtos.hh"
+#include "rtos_test.hh"
+
+#include <cstddef>
+#include <cstdint>
+
+constexpr size_t period = 10;
+
+int main() {
+    rtos_test::setup();
+
+    // Released at the same ticks as the periodic task and delays it by 3 ticks
+    // each period.
+    rtos_test::TaskWithStack interferer(2, false, []{
+        size_t last_wake;
+        while (true) {
+            rtos::task::sleep_until(last_wake, period);
+            HAL_Delay(3);
+        }
+    });
+
+    rtos_test::TaskWithStack periodic(1, false, []{
+        size_t last_wake;
+        rtos::task::sleep_until(last_wake, period);
+        const size_t first_wake = last_wake;
+        const uint32_t first_time = HAL_GetTick();
+
+        // The amount of work done each period varies but the wake times
+        // don't drift.
+        for (size_t i = 1; i <= 10; ++i) {
+            HAL_Delay(i % 4);
+            rtos::task::sleep_until(last_wake, period);
+            EXPECT(last_wake == first_wake + i * period);
+        }
+        const uint32_t elapsed = HAL_GetTick() - first_time;
+        EXPECT(elapsed >= 10 * period - 1 && elapsed <= 10 * period + 1);
+
+        rtos::Task::Stats stats = rtos::task::stats(rtos::task::self());
+        EXPECT(stats.overruns == 0);
+        EXPECT(stats.max_release_jitter >= 3);
+        EXPECT(stats.max_response_time < period);
+
+        // Overrun the next two releases. Neither call sleeps.
+        HAL_Delay(2 * period + 1);
+        rtos::task::sleep_until(last_wake, period);
+        rtos::task::sleep_until(last_wake, period);
+        stats = rtos::task::stats(rtos::task::self());
+        EXPECT(stats.overruns == 2);
+        EXPECT(stats.max_response_time >= 2 * period + 1);
+
+        // The task goes back to sleeping on the original schedule.
+        rtos::task::sleep_until(last_wake, period);
+        EXPECT(last_wake == first_wake + 13 * period);
+        EXPECT(rtos::task::stats(rtos::task::self()).overruns == 2);
+
+        rtos_test::pass();
+    });
+
+    rtos::start();
+}
@@ -0,0 +1,44 @@
+#include "rtos.hh"
+#include "rtos_test.hh"
+
+#include <cstdint>
+
+// Built with RTOS_ENABLE_TICKLESS_IDLE=1
+
+namespace {
+
+constexpr uint32_t sleep_ticks = 500;
+
+uint32_t elapsed_ms(uint32_t start) {
+    return (rtos_test::timer_counter() + 1000 - start) % 1000;
+}
+
+} // namespace
+
+int main() {
+    rtos_test::setup();
+
+    rtos_test::TaskWithStack task(0, false, []{
+        rtos_test::start_timer();
+
+        // Only the idle task runs while sleeping so almost every tick should
+        // be suppressed.
+        const uint32_t systicks_before = rtos_test::systick_count();
+        uint32_t start = rtos_test::timer_counter();
+        rtos::task::sleep(sleep_ticks);
+        EXPECT(elapsed_ms(start) >= sleep_ticks - 1);
+        EXPECT(rtos_test::systick_count() - systicks_before < 10);
+
+        // The tick count must have been caught up so that short sleeps after
+        // a tickless period still take the right amount of time.
+        start = rtos_test::timer_counter();
+        for (int i = 0; i < 10; ++i) {
+            rtos::task::sleep(5);
+        }
+        EXPECT(elapsed_ms(start) >= 45);
+
+        rtos_test::pass();
+    });
+
+    rtos::start();
+}
@@ -0,0 +1,84 @@
+#include "rtos.hh"
+#include "rtos_test.hh"
+
+#include <cstdint>
+#include <optional>
+
+namespace {
+
+std::optional<rtos::Mutex> mutex;
+std::optional<rtos::Mutex> cond_mutex;
+std::optional<rtos::Cond> cond;
+std::optional<rtos::Mqueue<int, 1>> mqueue;
+std::optional<rtos_test::TaskWithStack<>> holder;
+
+// Checks that a wait that timed out took the full timeout and no more than a
+// tick longer.
+void expect_elapsed(uint64_t start, uint64_t timeout) {
+    const uint64_t elapsed = rtos::time_now() - start;
+    EXPECT(elapsed >= timeout && elapsed <= timeout + 1);
+}
+
+} // namespace
+
+int main() {
+    rtos_test::setup();
+
+    mutex.emplace();
+    cond_mutex.emplace(1);
+    cond.emplace();
+    mqueue.emplace();
+
+    holder.emplace(0, false, []{
+        mutex->lock();
+        rtos_test::checkpoint(2);
+        rtos::task::sleep(50);
+        mutex->unlock();
+    });
+
+    rtos_test::TaskWithStack task0(1, false, []{
+        rtos_test::checkpoint(1);
+        rtos::task::sleep(1);
+
+        uint64_t start = rtos::time_now();
+        EXPECT(!mutex->lock_timed(5));
+        expect_elapsed(start, 5);
+        EXPECT(!mutex->lock_timed(0));
+
+        int value;
+        start = rtos::time_now();
+        EXPECT(!mqueue->dequeue_timed(value, 3));
+        expect_elapsed(start, 3);
+
+        mqueue->enqueue(1);
+        start = rtos::time_now();
+        EXPECT(!mqueue->enqueue_timed(2, 2));
+        expect_elapsed(start, 2);
+        EXPECT(mqueue->dequeue_timed(value, 2));
+        EXPECT(value == 1);
+
+        // The mutex is held again after the cond wait times out
+        cond_mutex->lock();
+        start = rtos::time_now();
+        EXPECT(!cond->wait_timed(*cond_mutex, 4));
+        expect_elapsed(start, 4);
+        cond_mutex->unlock();
+
+        start = rtos::time_now();
+        EXPECT(!rtos::task::join_timed(&holder.value(), 2));
+        expect_elapsed(start, 2);
+
+        // The holder unlocks before the timeout, which must then not fire
+        EXPECT(mutex->lock_timed(100));
+        rtos_test::checkpoint(3);
+        EXPECT(rtos::time_now() - start < 100);
+        mutex->unlock();
+        EXPECT(rtos::task::join_timed(&holder.value(), 100));
+
+        rtos::task::sleep(150);
+        rtos_test::checkpoint(4);
+        rtos_test::pass();
+    });
+
+    rtos::start();
+}